@@ -0,0 +1,321 @@
+#include "analyzer.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+using namespace std;
+
+// Constructor. image must point at a full MEMORY_SIZE byte memory image.
+ROMAnalyzer::ROMAnalyzer(const uint8_t* image, bool load_store_inc_i)
+    : memory(image), return_i({ 0, 0 }), has_return(false), has_indirect_jump(false), load_store_inc_i(load_store_inc_i) {
+    i_range.assign(MEMORY_SIZE, { 0, 0 });
+    depth.assign(MEMORY_SIZE, { 0, 0 });
+}
+
+uint16_t ROMAnalyzer::opcodeAt(uint16_t address) const {
+    if (address >= MEMORY_SIZE - 1) {
+        return 0;
+    }
+    return (memory[address] << 8) | memory[address + 1];
+}
+
+// Joins the incoming state into the state of address. Returns true if it changed.
+bool ROMAnalyzer::merge(uint16_t address, Range in_i, Range in_depth) {
+    if (address >= MEMORY_SIZE - 1) { // The fetch bounds check stops the emulator here
+        return false;
+    }
+
+    if (!reachable[address]) {
+        reachable[address] = true;
+        i_range[address] = in_i;
+        depth[address] = in_depth;
+        return true;
+    }
+
+    Range& i = i_range[address];
+    Range& d = depth[address];
+    Range new_i = { min(i.lo, in_i.lo), max(i.hi, in_i.hi) };
+    Range new_d = { min(d.lo, in_depth.lo), max(d.hi, in_depth.hi) };
+    if (new_i.lo == i.lo && new_i.hi == i.hi && new_d.lo == d.lo && new_d.hi == d.hi) {
+        return false;
+    }
+    i = new_i;
+    d = new_d;
+    return true;
+}
+
+// Control flow successors of the instruction at address. For 2NNN these are the call target and the return site.
+void ROMAnalyzer::successors(uint16_t address, vector<uint16_t>& out) {
+    out.clear();
+    uint16_t op = opcodeAt(address);
+    uint16_t nnn = op & 0x0FFF;
+
+    switch (op >> 12) {
+        case 0x0:
+            if (op != 0x00EE) {
+                out.push_back(address + 2);
+            }
+            break;
+        case 0x1:
+            out.push_back(nnn);
+            break;
+        case 0x2:
+            out.push_back(nnn);
+            out.push_back(address + 2);
+            break;
+        case 0x3: case 0x4: case 0x5: case 0x9:
+            out.push_back(address + 2);
+            out.push_back(address + 4);
+            break;
+        case 0xB: // Target depends on V0
+            break;
+        case 0xE:
+            out.push_back(address + 2);
+            if ((op & 0x00FF) == 0x9E || (op & 0x00FF) == 0xA1) {
+                out.push_back(address + 4);
+            }
+            break;
+        case 0xF:
+            if ((op & 0x00FF) == 0x0A) { // Spins on itself until a key is pressed
+                out.push_back(address);
+            }
+            out.push_back(address + 2);
+            break;
+        default:
+            out.push_back(address + 2);
+            break;
+    }
+}
+
+// Worklist fixpoint over the reachable instructions
+void ROMAnalyzer::analyze() {
+    reachable.reset();
+    safe.reset();
+    return_sites.clear();
+    blocks.clear();
+    has_return = false;
+    has_indirect_jump = false;
+
+    vector<uint16_t> worklist;
+    vector<uint16_t> succs;
+    merge(PROGRAM_START, { 0, 0 }, { 0, 0 }); // I and sp are zero on reset
+    worklist.push_back(PROGRAM_START);
+
+    while (!worklist.empty()) {
+        uint16_t address = worklist.back();
+        worklist.pop_back();
+
+        uint16_t op = opcodeAt(address);
+        Range in_i = i_range[address];
+        Range in_depth = depth[address];
+        Range out_i = in_i;
+
+        if (op == 0x00EE) {
+            // Every return site resumes with the I of any return
+            Range joined = has_return ? Range{ min(return_i.lo, in_i.lo), max(return_i.hi, in_i.hi) } : in_i;
+            if (!has_return || joined.lo != return_i.lo || joined.hi != return_i.hi) {
+                has_return = true;
+                return_i = joined;
+                for (uint16_t call : return_sites) {
+                    if (merge(call + 2, return_i, depth[call])) {
+                        worklist.push_back(call + 2);
+                    }
+                }
+            }
+            continue;
+        }
+
+        if ((op >> 12) == 0x2) {
+            // A call that would overflow stops the emulator, so surviving paths stay within the stack
+            Range callee_depth = { (uint16_t)min(in_depth.lo + 1, STACK_SIZE - 1), (uint16_t)min(in_depth.hi + 1, STACK_SIZE - 1) };
+            if (merge(op & 0x0FFF, in_i, callee_depth)) {
+                worklist.push_back(op & 0x0FFF);
+            }
+            if (find(return_sites.begin(), return_sites.end(), address) == return_sites.end()) {
+                return_sites.push_back(address);
+            }
+            if (has_return && merge(address + 2, return_i, in_depth)) {
+                worklist.push_back(address + 2);
+            }
+            continue;
+        }
+
+        if ((op >> 12) == 0xA) { // ANNN
+            out_i = { (uint16_t)(op & 0x0FFF), (uint16_t)(op & 0x0FFF) };
+        }
+        else if ((op >> 12) == 0xB) { // BNNN
+            has_indirect_jump = true;
+        }
+        else if ((op >> 12) == 0xF && (op & 0x00FF) == 0x1E) { // FX1E wraps at 0xFFF
+            if (in_i.hi + 255 > 0xFFF) {
+                out_i = { 0, 0xFFF };
+            }
+            else {
+                out_i = { in_i.lo, (uint16_t)(in_i.hi + 255) };
+            }
+        }
+        else if (load_store_inc_i && (op >> 12) == 0xF && ((op & 0x00FF) == 0x55 || (op & 0x00FF) == 0x65)) {
+            // I ends up past V[X]. Paths that survive the bounds check leave it at 0x1000 at most, which also keeps the fixpoint finite.
+            uint16_t step = ((op & 0x0F00) >> 8) + 1;
+            out_i = { (uint16_t)min(in_i.lo + step, (int)MEMORY_SIZE), (uint16_t)min(in_i.hi + step, (int)MEMORY_SIZE) };
+        }
+        else if ((op >> 12) == 0xF && (op & 0x00FF) == 0x29) { // FX29
+            out_i = { FONTSET_START, FONTSET_START + 255 * 5 };
+        }
+
+        successors(address, succs);
+        for (uint16_t next : succs) {
+            if (merge(next, out_i, in_depth)) {
+                worklist.push_back(next);
+            }
+        }
+    }
+
+    // Without the target of a BNNN the graph is incomplete, so nothing is proven
+    if (!has_indirect_jump) {
+        for (int address = 0; address < MEMORY_SIZE; ++address) {
+            if (reachable[address] && checksProven(address)) {
+                safe[address] = true;
+            }
+        }
+    }
+
+    buildBlocks();
+}
+
+// True if every runtime check of the instruction at address is known to pass
+bool ROMAnalyzer::checksProven(uint16_t address) {
+    uint16_t op = opcodeAt(address);
+    uint8_t X = (op & 0x0F00) >> 8;
+    Range i = i_range[address];
+    Range d = depth[address];
+
+    if (op == 0x00EE) {
+        return d.lo >= 1;
+    }
+    switch (op >> 12) {
+        case 0x2:
+            return d.hi < STACK_SIZE - 1;
+        case 0xD:
+            return i.hi + (op & 0x000F) <= MEMORY_SIZE;
+        case 0xF:
+            switch (op & 0x00FF) {
+                case 0x33: return i.hi + 2 < MEMORY_SIZE;
+                case 0x55: return i.hi + X < MEMORY_SIZE;
+                case 0x65: return i.hi + X < MEMORY_SIZE;
+                default: return true;
+            }
+        default:
+            return true;
+    }
+}
+
+// Splits the reachable instructions into basic blocks
+void ROMAnalyzer::buildBlocks() {
+    bitset<MEMORY_SIZE> leaders;
+    vector<uint16_t> succs;
+    leaders[PROGRAM_START] = true;
+
+    for (int address = 0; address < MEMORY_SIZE; ++address) {
+        if (!reachable[address]) {
+            continue;
+        }
+        successors(address, succs);
+        bool falls_through = succs.size() == 1 && succs[0] == address + 2;
+        if (!falls_through) {
+            for (uint16_t next : succs) {
+                if (next < MEMORY_SIZE) {
+                    leaders[next] = true;
+                }
+            }
+        }
+    }
+
+    for (int address = 0; address < MEMORY_SIZE; ++address) {
+        if (!reachable[address] || !leaders[address]) {
+            continue;
+        }
+        uint16_t end = address;
+        while (true) {
+            successors(end, succs);
+            bool falls_through = succs.size() == 1 && succs[0] == end + 2;
+            if (!falls_through || end + 2 >= MEMORY_SIZE || !reachable[end + 2] || leaders[end + 2]) {
+                break;
+            }
+            end += 2;
+        }
+        blocks.push_back({ (uint16_t)address, (uint16_t)(end + 2), succs });
+    }
+}
+
+// Mnemonic for a single opcode
+string ROMAnalyzer::disassemble(uint16_t op) {
+    char text[32];
+    int X = (op & 0x0F00) >> 8;
+    int Y = (op & 0x00F0) >> 4;
+    int N = op & 0x000F;
+    int NN = op & 0x00FF;
+    int NNN = op & 0x0FFF;
+
+    switch (op >> 12) {
+        case 0x0:
+            if (op == 0x00E0) return "CLS";
+            if (op == 0x00EE) return "RET";
+            snprintf(text, sizeof(text), "SYS 0x%03X", NNN);
+            break;
+        case 0x1: snprintf(text, sizeof(text), "JP 0x%03X", NNN); break;
+        case 0x2: snprintf(text, sizeof(text), "CALL 0x%03X", NNN); break;
+        case 0x3: snprintf(text, sizeof(text), "SE V%X, 0x%02X", X, NN); break;
+        case 0x4: snprintf(text, sizeof(text), "SNE V%X, 0x%02X", X, NN); break;
+        case 0x5: snprintf(text, sizeof(text), "SE V%X, V%X", X, Y); break;
+        case 0x6: snprintf(text, sizeof(text), "LD V%X, 0x%02X", X, NN); break;
+        case 0x7: snprintf(text, sizeof(text), "ADD V%X, 0x%02X", X, NN); break;
+        case 0x8:
+            switch (N) {
+                case 0x0: snprintf(text, sizeof(text), "LD V%X, V%X", X, Y); break;
+                case 0x1: snprintf(text, sizeof(text), "OR V%X, V%X", X, Y); break;
+                case 0x2: snprintf(text, sizeof(text), "AND V%X, V%X", X, Y); break;
+                case 0x3: snprintf(text, sizeof(text), "XOR V%X, V%X", X, Y); break;
+                case 0x4: snprintf(text, sizeof(text), "ADD V%X, V%X", X, Y); break;
+                case 0x5: snprintf(text, sizeof(text), "SUB V%X, V%X", X, Y); break;
+                case 0x6: snprintf(text, sizeof(text), "SHR V%X, V%X", X, Y); break;
+                case 0x7: snprintf(text, sizeof(text), "SUBN V%X, V%X", X, Y); break;
+                case 0xE: snprintf(text, sizeof(text), "SHL V%X, V%X", X, Y); break;
+                default: snprintf(text, sizeof(text), "DW 0x%04X", op); break;
+            }
+            break;
+        case 0x9: snprintf(text, sizeof(text), "SNE V%X, V%X", X, Y); break;
+        case 0xA: snprintf(text, sizeof(text), "LD I, 0x%03X", NNN); break;
+        case 0xB: snprintf(text, sizeof(text), "JP V0, 0x%03X", NNN); break;
+        case 0xC: snprintf(text, sizeof(text), "RND V%X, 0x%02X", X, NN); break;
+        case 0xD: snprintf(text, sizeof(text), "DRW V%X, V%X, %d", X, Y, N); break;
+        case 0xE:
+            if (NN == 0x9E) snprintf(text, sizeof(text), "SKP V%X", X);
+            else if (NN == 0xA1) snprintf(text, sizeof(text), "SKNP V%X", X);
+            else snprintf(text, sizeof(text), "DW 0x%04X", op);
+            break;
+        case 0xF:
+            switch (NN) {
+                case 0x07: snprintf(text, sizeof(text), "LD V%X, DT", X); break;
+                case 0x0A: snprintf(text, sizeof(text), "LD V%X, K", X); break;
+                case 0x15: snprintf(text, sizeof(text), "LD DT, V%X", X); break;
+                case 0x18: snprintf(text, sizeof(text), "LD ST, V%X", X); break;
+                case 0x1E: snprintf(text, sizeof(text), "ADD I, V%X", X); break;
+                case 0x29: snprintf(text, sizeof(text), "LD F, V%X", X); break;
+                case 0x33: snprintf(text, sizeof(text), "LD B, V%X", X); break;
+                case 0x55: snprintf(text, sizeof(text), "LD [I], V%X", X); break;
+                case 0x65: snprintf(text, sizeof(text), "LD V%X, [I]", X); break;
+                default: snprintf(text, sizeof(text), "DW 0x%04X", op); break;
+            }
+            break;
+    }
+    return text;
+}
+
+void ROMAnalyzer::layoutImage(const uint8_t* rom, size_t rom_size, uint8_t* image) {
+    memset(image, 0, MEMORY_SIZE);
+    memcpy(&image[FONTSET_START], FONTSET, FONTSET_SIZE);
+    if (rom_size > 0) {
+        memcpy(&image[PROGRAM_START], rom, rom_size);
+    }
+}
@@ -0,0 +1,96 @@
+#pragma once // Ensures this header file is included only once
+
+#include <bitset>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Load time analysis of a CHIP-8 memory image. Recovers the control flow graph from PROGRAM_START
+// and tracks the possible values of I and the stack depth at every reachable instruction, so the
+// emulator can skip bounds checks that can never fail.
+class ROMAnalyzer {
+public:
+    static constexpr uint16_t MEMORY_SIZE = 4096;
+    static constexpr uint16_t PROGRAM_START = 0x200;
+    static constexpr uint16_t FONTSET_START = 0x50;
+    static constexpr uint16_t FONTSET_SIZE = 80;
+    static constexpr uint16_t MAX_ROM_SIZE = MEMORY_SIZE - PROGRAM_START;
+    static constexpr int STACK_SIZE = 16;
+
+    // Font data
+    static constexpr uint8_t FONTSET[FONTSET_SIZE] = {
+        0xF0, 0x90, 0x90, 0x90, 0xF0, // 0
+        0x20, 0x60, 0x20, 0x20, 0x70, // 1
+        0xF0, 0x10, 0xF0, 0x80, 0xF0, // 2
+        0xF0, 0x10, 0xF0, 0x10, 0xF0, // 3
+        0x90, 0x90, 0xF0, 0x10, 0x10, // 4
+        0xF0, 0x80, 0xF0, 0x10, 0xF0, // 5
+        0xF0, 0x80, 0xF0, 0x90, 0xF0, // 6
+        0xF0, 0x10, 0x20, 0x40, 0x40, // 7
+        0xF0, 0x90, 0xF0, 0x90, 0xF0, // 8
+        0xF0, 0x90, 0xF0, 0x10, 0xF0, // 9
+        0xF0, 0x90, 0xF0, 0x90, 0x90, // A
+        0xE0, 0x90, 0xE0, 0x90, 0xE0, // B
+        0xF0, 0x80, 0x80, 0x80, 0xF0, // C
+        0xE0, 0x90, 0x90, 0x90, 0xE0, // D
+        0xF0, 0x80, 0xF0, 0x80, 0xF0, // E
+        0xF0, 0x80, 0xF0, 0x80, 0x80  // F
+    };
+
+    // Inclusive range of values
+    struct Range {
+        uint16_t lo;
+        uint16_t hi;
+    };
+
+    // Straight line run of instructions [start, end) with its successors
+    struct BasicBlock {
+        uint16_t start;
+        uint16_t end;
+        std::vector<uint16_t> successors;
+    };
+
+private:
+    const uint8_t* memory;
+
+    // Per instruction state on entry. Only valid where reachable is set.
+    std::bitset<MEMORY_SIZE> reachable;
+    std::bitset<MEMORY_SIZE> safe;
+    std::vector<Range> i_range;
+    std::vector<Range> depth;
+    std::vector<uint16_t> return_sites;
+    Range return_i;           // I at any reachable 00EE
+    bool has_return;
+    bool has_indirect_jump;   // BNNN makes the graph incomplete
+    bool load_store_inc_i;    // FX55/FX65 advance I (QUIRK_LOAD_STORE_INC_I)
+    std::vector<BasicBlock> blocks;
+
+    // Analysis helpers
+    bool merge(uint16_t address, Range in_i, Range in_depth);
+    void successors(uint16_t address, std::vector<uint16_t>& out);
+    bool checksProven(uint16_t address);
+    void buildBlocks();
+
+public:
+    ROMAnalyzer(const uint8_t* image, bool load_store_inc_i = false);
+
+    // Runs the analysis over the full 4 KB image
+    void analyze();
+
+    // Results
+    uint16_t opcodeAt(uint16_t address) const;
+    bool isReachable(uint16_t address) const { return reachable[address]; }
+    bool isSafe(uint16_t address) const { return safe[address]; }
+    bool hasIndirectJump() const { return has_indirect_jump; }
+    Range iRangeAt(uint16_t address) const { return i_range[address]; }
+    Range stackDepthAt(uint16_t address) const { return depth[address]; }
+    const std::vector<BasicBlock>& getBlocks() const { return blocks; }
+
+    // Mnemonic for a single opcode, e.g. "LD I, 0x22A"
+    static std::string disassemble(uint16_t opcode);
+
+    // Fills a 4 KB image the way the emulator lays out memory: fontset at FONTSET_START, ROM at PROGRAM_START,
+    // zero everywhere else. rom_size must be at most MAX_ROM_SIZE.
+    static void layoutImage(const uint8_t* rom, size_t rom_size, uint8_t* image);
+};
@@ -1,108 +1,46 @@
 #include "chip8.h"
+#include "debugger.h"
+#include "analyzer.h"
+#include "metrics.h"
+#include "logger.h"
+#include "mapped_file.h"
 #include <iostream>
 #include <fstream>
 #include <cstdlib>
 #include <iomanip>
-#include <ctime>
 #include <sstream>
-#ifdef _WIN32
-    #include <direct.h>
-#define MKDIR(path) _mkdir(path)
-#else
-    #include <sys/stat.h>
-    #define MKDIR(path) mkdir(path, 0755)
-#endif
+#include <cstring>
+#include <cstdio>
+#include <algorithm>
+#include <map>
+#include <mutex>
 
 using namespace std;
 using namespace chrono;
 
-// Get current timestamp for logging (format: YYYY-MM-DD_HH-MM-SS_mmm)
-string CHIP8::getCurrentTimestamp() {
-    auto now = system_clock::now(); // std::chrono::system_clock::time_point object
-    auto time = system_clock::to_time_t(now); // converts into time_t integer
-    auto ms = duration_cast<milliseconds>(now.time_since_epoch()) % 1000; // gets milliseconds since epoch
-    
-    stringstream ss;
-    #ifdef _WIN32
-        struct tm timeinfo;
-        localtime_s(&timeinfo, &time); // fills timeinfo with current time data
-        ss << put_time(&timeinfo, "%Y-%m-%d_%H-%M-%S");
-    #else
-        ss << put_time(localtime(&time), "%Y-%m-%d_%H-%M-%S");
-    #endif
-    ss << "_" << setfill('0') << setw(3) << ms.count();
-    
-    return ss.str();
-}
-
-// Create directory if it doesn't exist (cross-platform)
-bool CHIP8::createDirectory(const string& path) {
-    try {
-        // Check if directory exists by trying to open a file in it
-        string test_file = path + "/.test";
-        ofstream test(test_file);
-        if (test.good()) {
-            test.close();
-            // Directory exists, delete test file
-            remove(test_file.c_str());
-            return true;
-        }
-        test.close();
-        
-        // Directory doesn't exist, try to create it
-        if (MKDIR(path.c_str()) == 0) {
-            return true;
-        }
-        return false;
-    } 
-    catch (const exception& e) {
-        cerr << "Error creating directory: " << e.what() << endl;
-        return false;
-    }
-}
+// Metrics shared by every emulator instance in the process
+static MetricCounter& instructions_total = MetricsRegistry::instance().counter("chip8_instructions_total", "Instructions executed");
+static MetricCounter& frames_total = MetricsRegistry::instance().counter("chip8_frames_total", "Frames emulated");
+static MetricCounter& missed_deadlines_total = MetricsRegistry::instance().counter("chip8_missed_frame_deadlines_total", "Frames that were not done by their deadline");
+static MetricCounter& dropped_input_total = MetricsRegistry::instance().counter("chip8_input_events_dropped_total", "Key events dropped because the input queue was full");
+static MetricGauge& instructions_per_second = MetricsRegistry::instance().gauge("chip8_instructions_per_second", "Instructions executed over the last second");
+static MetricGauge& idle_ratio = MetricsRegistry::instance().gauge("chip8_idle_ratio", "Fraction of the last second spent sleeping between frames");
+static MetricHistogram& frame_seconds = MetricsRegistry::instance().histogram("chip8_frame_seconds", "Wall time per frame including the sleep",
+    { 0.001, 0.002, 0.004, 0.008, 0.012, 0.016, 0.017, 0.018, 0.020, 0.025, 0.033, 0.050, 0.100, 1.0 });
+static MetricHistogram& sleep_overshoot_seconds = MetricsRegistry::instance().histogram("chip8_sleep_overshoot_seconds", "How late the frame sleep woke up",
+    { 0.00005, 0.0001, 0.00025, 0.0005, 0.001, 0.002, 0.004, 0.008 });
+static MetricHistogram& render_seconds = MetricsRegistry::instance().histogram("chip8_render_seconds", "Texture upload and present time",
+    { 0.0001, 0.00025, 0.0005, 0.001, 0.002, 0.004, 0.008, 0.016 });
 
-// Initialize logging system
-void CHIP8::initializeLogging() {
-    log_directory = "./logs";
-    
-    // Create logs directory if it doesn't exist
-    if (!createDirectory(log_directory)) {
-        cerr << "Warning: Could not create logs directory" << endl;
-        return;
-    }
- 
-    // Create log filename with current timestamp
-    string timestamp = getCurrentTimestamp();
-    log_filename = log_directory + "/" + timestamp + ".txt";
-    
-    // Open log file for appending
-    log_file.open(log_filename, ios::app);
-    
-    if (!log_file.is_open()) {
-        cerr << "Warning: Could not open log file: " << log_filename << endl;
-        return;
-    }
-    
-    // Write header to log file
-    writeToLog("========================================");
-    writeToLog("CHIP-8 Emulator Log");
-    writeToLog("Started at: " + timestamp);
-    writeToLog("========================================");
-    writeToLog("");
-}
-
-// Write message to both log file and console
-void CHIP8::writeToLog(const string& message) {
-    if (log_file.is_open()) {
-        log_file << message << endl;
-        log_file.flush();  // Flush to ensure data is written immediately
-    }
-}
+// Keeps per-instance state small for batch runs with huge instance counts
+static_assert(sizeof(CHIP8) <= 1024, "CHIP8 instance state should stay under 1 KB");
 
 // Constructor
-CHIP8::CHIP8() : pc(PROGRAM_START), sp(0), delay_timer(0), sound_timer(0), rom_loaded(false) {
-    // Initializes memory, registers, keys, display, and opcode to zero
-    memset(memory, 0, MEMORY_SIZE);
+CHIP8::CHIP8() : owned_pages(0), pc(PROGRAM_START), sp(0), delay_timer(0), sound_timer(0), rng_state(RNG_SEED), rom_loaded(false),
+                 dispatch(nullptr), unchecked_allowed(false), debugger(nullptr), run_ahead_frames(0), speculating(false), quiet(false), quirks(0),
+                 cycles_per_frame(CYCLES_PER_FRAME), catalog(nullptr), catalog_index(0), next_input_cycle(InputQueue::NO_EVENT),
+                 cycle_count(0), frame_end_cycle(0), hashed_pages(0) {
+    // Initializes registers, keys, display, and opcode to zero
     memset(V, 0, sizeof(V));        
     memset(key, 0, sizeof(key));    
     memset(display, 0, sizeof(display));
@@ -111,73 +49,335 @@ CHIP8::CHIP8() : pc(PROGRAM_START), sp(0), delay_timer(0), sound_timer(0), rom_l
     I = 0;
     opcode = 0;
     
-    // Initialize logging
-    initializeLogging();
-    
-    // Load fontset into memory
-    for (int i = 0; i < FONTSET_SIZE; ++i) {
-        memory[FONTSET_START + i] = chip8_fontset[i];
-    }
-    
-    // Initialize timing
-    last_cycle_time = high_resolution_clock::now();
-    last_timer_update = high_resolution_clock::now();
+    // Memory starts out as the shared fontset image
+    attachImage(fontImage());
 }
 
 // Destructor
 CHIP8::~CHIP8() {
-    writeToLog("");
-    writeToLog("========================================");
-    writeToLog("Finished running!");
-    writeToLog("========================================");
-    if (log_file.is_open()) {
-        log_file.close();
-    }
+    releasePages();
 }
 
-// Load ROM from file
-bool CHIP8::loadROM(const char* filename) {
-    ifstream ROM(filename, ios::binary);
-    if (!ROM.is_open()) {
-        writeToLog(string("Error: Could not open ROM file: ") + filename);
-        return false;
-    }
+// Write message to the process wide log file
+void CHIP8::writeToLog(const string& message) {
+    Logger::instance().write(message);
+}
+
+// Image with only the fontset, used until a ROM is loaded
+shared_ptr<const CHIP8::SharedImage> CHIP8::fontImage() {
+    static shared_ptr<const SharedImage> font_image = [] {
+        shared_ptr<SharedImage> new_image = make_shared<SharedImage>();
+        ROMAnalyzer::layoutImage(nullptr, 0, new_image->memory);
+        for (int i = 0; i < MEMORY_SIZE; ++i) {
+            new_image->dispatch[i] = &CHIP8::decodeAndExecute;
+        }
+        buildKeymap(*new_image);
+        return new_image;
+    }();
+    return font_image;
+}
+
+// Cache key for an image: the ROM's SHA-1 and every profile field, since both end up in the image
+static string imageKey(const uint8_t digest[SHA1::DIGEST_SIZE], const ROMProfile& profile) {
+    string key(reinterpret_cast<const char*>(digest), SHA1::DIGEST_SIZE);
+    key += (char)profile.quirks;
+    key += (char)profile.cycles_per_frame;
+    key += (char)profile.run_ahead_frames;
+    key.append(reinterpret_cast<const char*>(profile.keymap), sizeof(profile.keymap));
+    return key;
+}
+
+// Loads a ROM into a new shared image, or returns the image an instance still holds for the same ROM bytes
+// and profile. The file is mapped rather than read, and copied once into the image next to the fontset.
+// The cache lock is only held to look up and publish, so loads of different ROMs are analyzed in parallel.
+shared_ptr<const CHIP8::SharedImage> CHIP8::loadImage(const string& filename, const ROMProfile& profile) {
+    static mutex cache_lock;
+    static map<string, weak_ptr<const SharedImage>> cache;
     
-    // Get file size
-    ROM.seekg(0, ios::end);
-    streampos rom_size = ROM.tellg();
-    ROM.seekg(0, ios::beg);
+    MappedFile ROM;
+    if (!ROM.open(filename)) {
+        writeToLog("Error: Could not open ROM file: " + filename);
+        return nullptr;
+    }
     
-    int rom_bytes = static_cast<int>(rom_size);
-    const unsigned short MAX_ROM_SIZE = MEMORY_SIZE - PROGRAM_START;
+    size_t rom_bytes = ROM.size();
+    const unsigned short MAX_ROM_SIZE = ROMAnalyzer::MAX_ROM_SIZE;
     
     if (rom_bytes == 0) {
         writeToLog("Error: ROM file is empty!");
-        ROM.close();
-        return false;
+        return nullptr;
     }
     
     if (rom_bytes > MAX_ROM_SIZE) {
         stringstream ss;
         ss << "Error: ROM File Size (" << rom_bytes << " bytes) is too big! Max size: " << MAX_ROM_SIZE << " bytes";
         writeToLog(ss.str());
-        ROM.close();
-        return false;
+        return nullptr;
     }
     
-    // Read ROM into memory
-    ROM.read(reinterpret_cast<char*>(&memory[PROGRAM_START]), rom_bytes);
-    ROM.close();
+    // Hashing a ROM this small costs far less than analyzing it again
+    uint8_t digest[SHA1::DIGEST_SIZE];
+    SHA1 sha1;
+    sha1.update(ROM.data(), rom_bytes);
+    sha1.finish(digest);
+    string key = imageKey(digest, profile);
+    {
+        lock_guard<mutex> guard(cache_lock);
+        auto entry = cache.find(key);
+        shared_ptr<const SharedImage> cached = (entry != cache.end()) ? entry->second.lock() : nullptr;
+        if (cached) {
+            return cached;
+        }
+    }
     
-    rom_loaded = true;
+    // Fontset and ROM go into the image
+    shared_ptr<SharedImage> new_image = make_shared<SharedImage>();
+    ROMAnalyzer::layoutImage(ROM.data(), rom_bytes, new_image->memory);
+    ROM.close();
     
     stringstream ss;
     ss << "ROM loaded successfully: " << rom_bytes << " bytes";
     writeToLog(ss.str());
     
+    new_image->profile = profile;
+    buildKeymap(*new_image);
+    analyzeImage(*new_image);
+    
+    ss.str("");
+    ss << "ROM settings: run_ahead=" << (int)profile.run_ahead_frames << " cycles_per_frame=" << (int)profile.cycles_per_frame
+       << " quirks=0x" << hex << (int)profile.quirks;
+    writeToLog(ss.str());
+    
+    // Another thread may have built the same image meanwhile. Its copy wins so instances keep sharing one.
+    lock_guard<mutex> guard(cache_lock);
+    shared_ptr<const SharedImage> published = cache[key].lock();
+    if (published) {
+        return published;
+    }
+    
+    // Edited ROMs and profiles get new keys, so entries whose image is gone are dropped here
+    for (auto entry = cache.begin(); entry != cache.end();) {
+        entry = entry->second.expired() ? cache.erase(entry) : next(entry);
+    }
+    cache[key] = new_image;
+    return new_image;
+}
+
+// Load ROM from file
+bool CHIP8::loadROM(const char* filename) {
+    ROMProfile profile;
+    ROMCatalog::readProfile(filename, profile);
+    return loadROM(filename, profile);
+}
+
+// Load ROM from file with the given settings and start it from reset
+bool CHIP8::loadROM(const char* filename, const ROMProfile& profile) {
+    shared_ptr<const SharedImage> loaded = loadImage(filename, profile);
+    if (!loaded) {
+        return false;
+    }
+    
+    reset();
+    attachImage(loaded);
+    rom_loaded = true;
+    return true;
+}
+
+// Loads a ROM from the library with the profile stored in its index
+bool CHIP8::loadFromCatalog(const ROMCatalog& rom_catalog, size_t index) {
+    if (index >= rom_catalog.size() || !loadROM(rom_catalog.path(index).c_str(), rom_catalog.at(index).profile)) {
+        return false;
+    }
+    catalog = &rom_catalog;
+    catalog_index = index;
+    
+    recent_images.erase(remove(recent_images.begin(), recent_images.end(), image), recent_images.end());
+    recent_images.insert(recent_images.begin(), image);
+    if (recent_images.size() > RECENT_IMAGES) {
+        recent_images.pop_back();
+    }
+    writeToLog("Running ROM: " + rom_catalog.at(index).name + " (" + SHA1::toHex(rom_catalog.at(index).sha1) + ")");
     return true;
 }
 
+// Puts registers, keys, display and pending input back to their power on state
+void CHIP8::reset() {
+    memset(V, 0, sizeof(V));
+    memset(key, 0, sizeof(key));
+    memset(display, 0, sizeof(display));
+    memset(stack, 0, sizeof(stack));
+    I = 0;
+    pc = PROGRAM_START;
+    sp = 0;
+    delay_timer = 0;
+    sound_timer = 0;
+    opcode = 0;
+    rng_state = RNG_SEED;
+    if (input_queue) {
+        input_queue->clear();
+    }
+    next_input_cycle = InputQueue::NO_EVENT;
+}
+
+// Points memory and the dispatch table at a shared image, dropping anything this instance had copied or patched
+void CHIP8::attachImage(const shared_ptr<const SharedImage>& new_image) {
+    releasePages();
+    image = new_image;
+    for (int i = 0; i < PAGE_COUNT; ++i) {
+        pages[i] = &image->memory[i * PAGE_SIZE];
+    }
+    
+    dispatch = image->dispatch;
+    private_dispatch.reset();
+    unchecked_allowed = image->unchecked.any();
+    run_ahead_frames = min((int)image->profile.run_ahead_frames, MAX_RUN_AHEAD);
+    quirks = image->profile.quirks;
+    cycles_per_frame = image->profile.cycles_per_frame ? image->profile.cycles_per_frame : CYCLES_PER_FRAME;
+    
+    if (debugger) {
+        debugger->reinsertTraps();
+    }
+}
+
+// Gives this instance its own copy of a page before the first write to it
+void CHIP8::copyPage(int page) {
+    uint8_t* copy = new uint8_t[PAGE_SIZE];
+    memcpy(copy, pages[page], PAGE_SIZE);
+    pages[page] = copy;
+    owned_pages |= (1u << page);
+}
+
+// Frees every copied page. The caller points pages back at an image.
+void CHIP8::releasePages() {
+    for (int i = 0; i < PAGE_COUNT; ++i) {
+        if (owned_pages & (1u << i)) {
+            delete[] const_cast<uint8_t*>(pages[i]);
+        }
+    }
+    owned_pages = 0;
+    hashed_pages = 0;
+}
+
+// Copy on write: pages still shared with other instances are copied first
+void CHIP8::writeMemory(uint16_t address, uint8_t value) {
+    int page = address >> PAGE_SHIFT;
+    if (!(owned_pages & (1u << page))) {
+        copyPage(page);
+    }
+    hashed_pages &= ~(1u << page);
+    const_cast<uint8_t*>(pages[page])[address & (PAGE_SIZE - 1)] = value; // Owned pages are ours to write
+}
+
+void CHIP8::setRunAhead(int frames) {
+    if (frames < 0) {
+        frames = 0;
+    }
+    if (frames > MAX_RUN_AHEAD) {
+        frames = MAX_RUN_AHEAD;
+    }
+    run_ahead_frames = frames;
+}
+
+// Copies the whole machine state out
+void CHIP8::saveState(Snapshot& state) const {
+    state.owned_pages = owned_pages;
+    for (int i = 0; i < PAGE_COUNT; ++i) {
+        if (owned_pages & (1u << i)) {
+            memcpy(state.pages[i], pages[i], PAGE_SIZE);
+        }
+    }
+    memcpy(state.V, V, sizeof(V));
+    memcpy(state.stack, stack, sizeof(stack));
+    memcpy(state.key, key, sizeof(key));
+    memcpy(state.display, display, sizeof(display));
+    state.I = I;
+    state.pc = pc;
+    state.sp = sp;
+    state.delay_timer = delay_timer;
+    state.sound_timer = sound_timer;
+    state.opcode = opcode;
+    state.rng_state = rng_state;
+    state.rom_loaded = rom_loaded;
+    state.unchecked_allowed = unchecked_allowed;
+    state.hashed_pages = hashed_pages;
+    if (hashed_pages) {
+        memcpy(state.page_hashes, page_hashes.get(), sizeof(state.page_hashes));
+    }
+}
+
+// Puts a saved machine state back. The snapshot must come from an instance running the same image.
+void CHIP8::loadState(const Snapshot& state) {
+    for (int i = 0; i < PAGE_COUNT; ++i) {
+        uint32_t bit = 1u << i;
+        if (state.owned_pages & bit) {
+            if (!(owned_pages & bit)) {
+                copyPage(i);
+            }
+            memcpy(const_cast<uint8_t*>(pages[i]), state.pages[i], PAGE_SIZE);
+        }
+        else if (owned_pages & bit) { // Written since the snapshot, go back to the shared page
+            delete[] const_cast<uint8_t*>(pages[i]);
+            pages[i] = &image->memory[i * PAGE_SIZE];
+            owned_pages &= ~bit;
+        }
+    }
+    memcpy(V, state.V, sizeof(V));
+    memcpy(stack, state.stack, sizeof(stack));
+    memcpy(key, state.key, sizeof(key));
+    memcpy(display, state.display, sizeof(display));
+    I = state.I;
+    pc = state.pc;
+    sp = state.sp;
+    delay_timer = state.delay_timer;
+    sound_timer = state.sound_timer;
+    opcode = state.opcode;
+    rng_state = state.rng_state;
+    rom_loaded = state.rom_loaded;
+    
+    // Whether self-modifying writes have invalidated the proofs is part of the state, so restored
+    // code that was rewritten never runs on unchecked handlers
+    if (unchecked_allowed && !state.unchecked_allowed) {
+        dropUncheckedHandlers();
+    }
+    else if (!unchecked_allowed && state.unchecked_allowed) {
+        restoreUncheckedHandlers();
+    }
+    
+    // Restored pages match the snapshot, so its page hashes still hold
+    hashed_pages = state.hashed_pages;
+    if (hashed_pages) {
+        if (!page_hashes) {
+            page_hashes = make_unique<uint64_t[]>(PAGE_COUNT);
+        }
+        memcpy(page_hashes.get(), state.page_hashes, sizeof(state.page_hashes));
+    }
+}
+
+// Emulates run_ahead_frames frames with the current input, keeps the display they produce and rolls back.
+// The player sees the result of their input that many frames earlier.
+// Speculative frames stay quiet, and proofs they invalidate are put back with the rest of the state.
+void CHIP8::runAhead(uint64_t* ahead_display) {
+    Snapshot state;
+    saveState(state);
+    speculating = true;
+    
+    // Run ahead with the keys as they will be once the queued events have landed
+    for (int i = 0; input_queue && i < input_queue->size(); ++i) {
+        key[input_queue->at(i).key] = input_queue->at(i).down ? 1 : 0;
+    }
+    
+    for (int frame = 0; frame < run_ahead_frames && rom_loaded; ++frame) {
+        for (int cycle = 0; cycle < cycles_per_frame && rom_loaded; ++cycle) {
+            execute_opcode();
+        }
+        tickTimers();
+    }
+    memcpy(ahead_display, display, sizeof(display));
+    
+    speculating = false;
+    loadState(state);
+}
+
 // Function to increase PC
 void CHIP8::incPC() {
     pc += 2;
@@ -193,25 +393,22 @@ void CHIP8::logOpcode(uint16_t op) {
     }
 }
 
-// Updates delay and sound timers by one, at 60 Hz if above 0
-void CHIP8::updateTimers() { 
-    auto current_time = high_resolution_clock::now();
-    auto elapsed = duration_cast<milliseconds>(current_time - last_timer_update).count();
-    
-    if (elapsed >= (1000 / TIMER_SPEED)) {
-        if (delay_timer > 0) {
-            delay_timer--;
-        }
-        if (sound_timer > 0) {
-            sound_timer--;
-        }
-        last_timer_update = current_time;
+// Decrements the delay and sound timers once
+void CHIP8::tickTimers() {
+    if (delay_timer > 0) {
+        delay_timer--;
+    }
+    if (sound_timer > 0) {
+        sound_timer--;
     }
 }
 
-// For CXNN
+// For CXNN. xorshift32 on rng_state, so a restored snapshot draws the same numbers again.
 int CHIP8::genRandomNum() { 
-    return rand() % 256;
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 17;
+    rng_state ^= rng_state << 5;
+    return rng_state >> 24;
 }
 
 // Out of bounds checkers
@@ -227,41 +424,289 @@ bool CHIP8::isValidKeyIndex(uint8_t key_index) {
     return key_index < 16;
 }
 
-// Handle keyboard input
+// Runs the static analyzer over a new image and points proven instructions at the unchecked handler
+void CHIP8::analyzeImage(SharedImage& new_image) {
+    ROMAnalyzer analyzer(new_image.memory, new_image.profile.quirks & QUIRK_LOAD_STORE_INC_I);
+    analyzer.analyze();
+    
+    new_image.unchecked.reset();
+    new_image.analyzed_code.reset();
+    int reachable_count = 0;
+    for (int i = 0; i < MEMORY_SIZE; ++i) {
+        if (analyzer.isReachable(i)) {
+            reachable_count++;
+            new_image.analyzed_code[i] = true;
+            new_image.analyzed_code[i + 1] = true;
+        }
+        if (analyzer.isSafe(i)) {
+            new_image.unchecked[i] = true;
+        }
+        new_image.dispatch[i] = new_image.unchecked[i] ? &CHIP8::decodeAndExecuteUnchecked : &CHIP8::decodeAndExecute;
+    }
+    
+    stringstream ss;
+    ss << "Analysis: " << new_image.unchecked.count() << " of " << reachable_count << " reachable instructions run unchecked";
+    if (analyzer.hasIndirectJump()) {
+        ss << " (BNNN found, bounds checks kept everywhere)";
+    }
+    writeToLog(ss.str());
+}
+
+// Scancode lookup table for the ROM's keymap. Keys the profile leaves at 0 keep the default layout.
+void CHIP8::buildKeymap(SharedImage& new_image) {
+    memset(new_image.keymap, -1, sizeof(new_image.keymap));
+    for (int i = 0; i < 16; ++i) {
+        uint16_t scancode = new_image.profile.keymap[i] ? new_image.profile.keymap[i] : DEFAULT_KEYMAP[i];
+        if (scancode < SDL_SCANCODE_COUNT) {
+            new_image.keymap[scancode] = i;
+        }
+    }
+}
+
+// Goes back to checked handlers everywhere, keeping debugger traps in place. Without traps this instance
+// switches to the font image's table, which is all checked handlers and shared, instead of copying one.
+void CHIP8::dropUncheckedHandlers() {
+    unchecked_allowed = false;
+    if (!private_dispatch) {
+        dispatch = fontImage()->dispatch;
+        return;
+    }
+    for (int i = 0; i < MEMORY_SIZE; ++i) {
+        if (private_dispatch[i] != &CHIP8::trapHandler) {
+            private_dispatch[i] = &CHIP8::decodeAndExecute;
+        }
+    }
+}
+
+// Undoes dropUncheckedHandlers. Only valid while memory matches what the proofs were made for.
+void CHIP8::restoreUncheckedHandlers() {
+    unchecked_allowed = true;
+    if (!private_dispatch) {
+        dispatch = image->dispatch;
+        return;
+    }
+    for (int i = 0; i < MEMORY_SIZE; ++i) {
+        if (private_dispatch[i] != &CHIP8::trapHandler) {
+            private_dispatch[i] = baseHandler(i);
+        }
+    }
+}
+
+// Handler an address falls back to when a debugger trap is removed
+CHIP8::OpHandler CHIP8::baseHandler(uint16_t address) {
+    return (unchecked_allowed && image->unchecked[address]) ? &CHIP8::decodeAndExecuteUnchecked : &CHIP8::decodeAndExecute;
+}
+
+// Copies the shared dispatch table the first time this instance needs to patch it
+CHIP8::OpHandler* CHIP8::writableDispatch() {
+    if (!private_dispatch) {
+        private_dispatch.reset(new OpHandler[MEMORY_SIZE]);
+        memcpy(private_dispatch.get(), dispatch, sizeof(OpHandler) * MEMORY_SIZE);
+        dispatch = private_dispatch.get();
+    }
+    return private_dispatch.get();
+}
+
+// Debugger trap installed in the dispatch table in place of the normal handler
+void CHIP8::trapHandler() {
+    if (debugger) {
+        debugger->onTrap();
+    }
+    else {
+        decodeAndExecute();
+    }
+}
+
+// Called by FX33 and FX55 after they write to memory
+void CHIP8::onMemoryWrite(uint16_t address, uint16_t length) {
+    // Writes into analyzed code invalidate the proofs behind the unchecked handlers
+    if (unchecked_allowed) {
+        for (int i = 0; i < length; ++i) {
+            if (image->analyzed_code[address + i]) {
+                if (reportsErrors()) {
+                    stringstream ss;
+                    ss << "Self-modifying write at 0x" << hex << (address + i) << dec << ", bounds checks re-enabled";
+                    writeToLog(ss.str());
+                }
+                dropUncheckedHandlers();
+                break;
+            }
+        }
+    }
+    
+    if (debugger) {
+        debugger->onMemoryWrite(address, length);
+    }
+}
+
+// Handle keyboard input. The event's position within the polling window becomes the same position within
+// the next frame, so input lands on a deterministic cycle no matter when events are polled.
 void CHIP8::handleKeyEvent(SDL_KeyboardEvent key_event) {
-    uint8_t key_state = (key_event.down) ? 1 : 0;
-    
-  switch (key_event.scancode) {
-    case SDL_SCANCODE_1: key[0x1] = key_state; break;
-    case SDL_SCANCODE_2: key[0x2] = key_state; break;
-    case SDL_SCANCODE_3: key[0x3] = key_state; break;
-    case SDL_SCANCODE_4: key[0xC] = key_state; break;
-    case SDL_SCANCODE_Q: key[0x4] = key_state; break;
-    case SDL_SCANCODE_W: key[0x5] = key_state; break;
-    case SDL_SCANCODE_E: key[0x6] = key_state; break;
-    case SDL_SCANCODE_R: key[0xD] = key_state; break;
-    case SDL_SCANCODE_A: key[0x7] = key_state; break;
-    case SDL_SCANCODE_S: key[0x8] = key_state; break;
-    case SDL_SCANCODE_D: key[0x9] = key_state; break;
-    case SDL_SCANCODE_F: key[0xE] = key_state; break;
-    case SDL_SCANCODE_Z: key[0xA] = key_state; break;
-    case SDL_SCANCODE_X: key[0x0] = key_state; break;
-    case SDL_SCANCODE_C: key[0xB] = key_state; break;
-    case SDL_SCANCODE_V: key[0xF] = key_state; break;
-    default: break;
+    int key_index = (key_event.scancode < SDL_SCANCODE_COUNT) ? image->keymap[key_event.scancode] : -1;
+    if (key_index < 0 || key_event.repeat) {
+        return;
+    }
+    
+    if (!input_queue) {
+        input_queue = make_unique<InputQueue>();
+    }
+    
+    uint64_t offset = 0;
+    uint64_t window = input_queue->windowEnd() - input_queue->windowStart();
+    if (window > 0 && key_event.timestamp > input_queue->windowStart()) {
+        offset = (key_event.timestamp - input_queue->windowStart()) * cycles_per_frame / window;
+        if (offset >= (uint64_t)cycles_per_frame) {
+            offset = cycles_per_frame - 1;
+        }
+    }
+    uint64_t cycle = cycle_count + offset;
+    
+    // Keep each key's events in order, and hold short presses for at least a frame so ROMs that poll once per frame still see them
+    uint64_t earliest = input_queue->lastCycle(key_index) + (key_event.down ? 0 : cycles_per_frame);
+    if (cycle < earliest) {
+        cycle = earliest;
+    }
+    
+    if (!input_queue->push(cycle, key_index, key_event.down)) {
+        dropped_input_total.add();
+        writeToLog("Warning: Input queue full, key event dropped");
+    }
+    next_input_cycle = input_queue->nextCycle();
+}
+
+// Applies every queued key event that is due at the current cycle
+void CHIP8::applyQueuedInput() {
+    while (cycle_count >= input_queue->nextCycle()) {
+        InputQueue::Event e = input_queue->pop();
+        key[e.key] = e.down ? 1 : 0;
+    }
+    next_input_cycle = input_queue->nextCycle();
+}
+
+// Runs one 60 Hz frame: cycles_per_frame instructions with queued input applied on its cycle, then one timer tick.
+// The frame ends on a cycle rather than after a count, so instructions stepped in the debugger count towards it.
+void CHIP8::runFrame() {
+    uint64_t start_cycle = cycle_count;
+    frame_end_cycle = cycle_count + cycles_per_frame;
+    while (cycle_count < frame_end_cycle && rom_loaded) {
+        if (cycle_count >= next_input_cycle) {
+            applyQueuedInput();
+        }
+        execute_opcode();
+        cycle_count++;
+    }
+    tickTimers();
+    
+    instructions_total.add(cycle_count - start_cycle);
+    frames_total.add();
+}
+
+// One debugger step, taking a cycle like an instruction in runFrame does. Crossing the frame's last cycle ticks
+// the timers and starts the next frame, and input due on the following cycle is applied before it runs.
+void CHIP8::stepCycle() {
+    decodeAndExecute();
+    cycle_count++;
+    if (cycle_count >= frame_end_cycle) {
+        tickTimers();
+        frame_end_cycle += cycles_per_frame;
+    }
+    if (cycle_count >= next_input_cycle) {
+        applyQueuedInput();
+    }
+}
+
+// Same as runFrame but stops before executing the instruction at address. Input queue and metrics are left alone.
+bool CHIP8::runFrameUntil(uint16_t address) {
+    for (int i = 0; i < cycles_per_frame && rom_loaded; ++i) {
+        if (pc == address) {
+            return true;
+        }
+        execute_opcode();
+        cycle_count++;
+    }
+    if (rom_loaded && pc == address) { // Reached by the frame's last instruction, so it counts for this frame
+        return true;
+    }
+    tickTimers();
+    return false;
+}
+
+// Sets the whole keypad at once
+void CHIP8::setKeys(uint16_t mask) {
+    for (int i = 0; i < 16; ++i) {
+        key[i] = (mask >> i) & 1;
     }
 }
 
+// FNV-1a
+static uint64_t hashBytes(const void* data, size_t length, uint64_t hash = 0xCBF29CE484222325ull) {
+    const uint8_t* bytes = static_cast<const uint8_t*>(data);
+    for (size_t i = 0; i < length; ++i) {
+        hash = (hash ^ bytes[i]) * 0x100000001B3ull;
+    }
+    return hash;
+}
+
+// Pages still shared with the image are the same in every state and are left out. Owned pages are
+// hashed once and cached until they are written again, so only the pages a frame touched get rehashed.
+uint64_t CHIP8::stateHash() {
+    if (!page_hashes) {
+        page_hashes = make_unique<uint64_t[]>(PAGE_COUNT);
+    }
+    
+    uint64_t hash = hashBytes(&owned_pages, sizeof(owned_pages));
+    for (int i = 0; i < PAGE_COUNT; ++i) {
+        uint32_t bit = 1u << i;
+        if (!(owned_pages & bit)) {
+            continue;
+        }
+        if (!(hashed_pages & bit)) {
+            page_hashes[i] = hashBytes(pages[i], PAGE_SIZE);
+            hashed_pages |= bit;
+        }
+        hash = hashBytes(&page_hashes[i], sizeof(uint64_t), hash);
+    }
+    
+    hash = hashBytes(V, sizeof(V), hash);
+    hash = hashBytes(&I, sizeof(I), hash);
+    hash = hashBytes(&pc, sizeof(pc), hash);
+    hash = hashBytes(&sp, sizeof(sp), hash);
+    hash = hashBytes(stack, (sp + 1) * sizeof(uint16_t), hash); // Entries above sp are stale
+    hash = hashBytes(&delay_timer, sizeof(delay_timer), hash);
+    hash = hashBytes(&sound_timer, sizeof(sound_timer), hash);
+    hash = hashBytes(&rng_state, sizeof(rng_state), hash);
+    return hashBytes(display, sizeof(display), hash);
+}
+
 // Execute opcode
 void CHIP8::execute_opcode() {
     // Fetch
     if (!isValidMemoryAddress(pc) || !isValidMemoryAddress(pc + 1)) {
-    cerr << "Error: Program counter out of bounds (0x" << hex << pc << dec << ")" << endl;
+        if (reportsErrors()) {
+            cerr << "Error: Program counter out of bounds (0x" << hex << pc << dec << ")" << endl;
+        }
         rom_loaded = false;
         return;
     }
     
-    opcode = (memory[pc] << 8) | memory[pc + 1];
+    // Dispatch through the table so breakpoints cost nothing when they are not set
+    (this->*dispatch[pc])();
+}
+
+// Handler for instructions that keep their bounds checks
+void CHIP8::decodeAndExecute() {
+    executeInstruction<true>();
+}
+
+// Handler for instructions the analyzer proved can never fail a bounds check
+void CHIP8::decodeAndExecuteUnchecked() {
+    executeInstruction<false>();
+}
+
+// Decode and execute the instruction at pc. CHECKED = false skips the I and stack bounds checks.
+template <bool CHECKED>
+void CHIP8::executeInstruction() {
+    opcode = (readMemory(pc) << 8) | readMemory(pc + 1);
     logOpcode(opcode);
     
     // Decode and Execute
@@ -269,8 +714,10 @@ void CHIP8::execute_opcode() {
         pc = opcode & 0x0FFF;
     }
     else if ((opcode >> 12) == 2) { // 2NNN: call
-        if (sp >= STACK_SIZE - 1) {
-            cerr << "Error: Stack overflow at 0x" << hex << pc << dec << endl;
+        if (CHECKED && sp >= STACK_SIZE - 1) {
+            if (reportsErrors()) {
+                cerr << "Error: Stack overflow at 0x" << hex << pc << dec << endl;
+            }
             rom_loaded = false;
             return;
         }
@@ -347,7 +794,9 @@ void CHIP8::execute_opcode() {
                 incPC();
                 break;
             case 0x6: // 8XY6: Shift V[X] one bit to the right
-                //V[VX] = V[VY]; //classic quirk
+                if (quirks & QUIRK_SHIFT_VY) {
+                    V[VX] = V[VY];
+                }
                 V[0xF] = V[VX] & 0x1;
                 V[VX] >>= 1;
                 incPC();
@@ -358,13 +807,17 @@ void CHIP8::execute_opcode() {
                 incPC();
                 break;
             case 0xE: // 8XYE: Shift V[X] one bit to the left
-                //V[VX] = V[VY]; // classic quirk
+                if (quirks & QUIRK_SHIFT_VY) {
+                    V[VX] = V[VY];
+                }
                 V[0xF] = (V[VX] & 0x80) >> 7;
                 V[VX] <<= 1;
                 incPC();
                 break;
             default:
-                cout << "Could not find opcode! Nibble: 8 Opcode: 0x" << hex << opcode << dec << endl;
+                if (reportsErrors()) {
+                    cout << "Could not find opcode! Nibble: 8 Opcode: 0x" << hex << opcode << dec << endl;
+                }
                 incPC();
                 break;
         }
@@ -396,13 +849,15 @@ void CHIP8::execute_opcode() {
         V[0xF] = 0;
         
         for (int i = 0; i < N; ++i) {
-            if (!isValidMemoryAddress(I + i)) { // I + i is the memory address where sprite data is loaded
-                cerr << "Error: Attempting to read sprite data from invalid memory address (0x" << hex << (I + i) << dec << ")" << endl;
+            if (CHECKED && !isValidMemoryAddress(I + i)) { // I + i is the memory address where sprite data is loaded
+                if (reportsErrors()) {
+                    cerr << "Error: Attempting to read sprite data from invalid memory address (0x" << hex << (I + i) << dec << ")" << endl;
+                }
                 rom_loaded = false;
                 break;
             }
    
-            uint8_t spriteByte = memory[I + i];
+            uint8_t spriteByte = readMemory(I + i);
             uint8_t drawY = (yCoord + i);
             if (drawY >= CHIP8_HEIGHT) {
                 break;
@@ -427,7 +882,9 @@ void CHIP8::execute_opcode() {
         uint8_t keyValue = V[VX];
     
         if (!isValidKeyIndex(keyValue)) {
-            cerr << "Warning: Key index out of bounds: " << (int)keyValue << endl;
+            if (reportsErrors()) {
+                cerr << "Warning: Key index out of bounds: " << (int)keyValue << endl;
+            }
             incPC();
             return;
         }
@@ -452,7 +909,9 @@ void CHIP8::execute_opcode() {
                 }
             break;
             default:
-                cout << "Could not find opcode! Nibble: E Opcode: 0x" << hex << opcode << dec << endl;
+                if (reportsErrors()) {
+                    cout << "Could not find opcode! Nibble: E Opcode: 0x" << hex << opcode << dec << endl;
+                }
                 incPC();
                 break;
         }
@@ -497,59 +956,75 @@ void CHIP8::execute_opcode() {
             break;
             case 0x29: // FX29: Set I to the location of the sprite data for digit V[X].
                 if (V[VX] > 0xF) {
-                    cerr << "Warning: FX29 - V[X] value (" << (int)V[VX] << ") exceeds valid font digit range (0-15)" << endl;
+                    if (reportsErrors()) {
+                        cerr << "Warning: FX29 - V[X] value (" << (int)V[VX] << ") exceeds valid font digit range (0-15)" << endl;
+                    }
                 }
                 I = FONTSET_START + (V[VX] * 5);
                 incPC();
                 break;
             case 0x33: // FX33: Store the binary-coded decimal representation of V[X] in memory at I, I+1, I+2.
             {
-                if (!isValidMemoryAddress(I) || !isValidMemoryAddress(I + 1) || !isValidMemoryAddress(I + 2)) {
-                    cerr << "Error: FX33 attempting to write to invalid memory address starting at 0x" << hex << I << dec << endl;
+                if (CHECKED && (!isValidMemoryAddress(I) || !isValidMemoryAddress(I + 1) || !isValidMemoryAddress(I + 2))) {
+                    if (reportsErrors()) {
+                        cerr << "Error: FX33 attempting to write to invalid memory address starting at 0x" << hex << I << dec << endl;
+                    }
                     rom_loaded = false;
                     break;
                 }
             
                 uint8_t value = V[VX];
-                memory[I] = value / 100;
-                memory[I + 1] = (value / 10) % 10;
-                memory[I + 2] = value % 10;
+                writeMemory(I, value / 100);
+                writeMemory(I + 1, (value / 10) % 10);
+                writeMemory(I + 2, value % 10);
+                onMemoryWrite(I, 3);
                 incPC();
             }
             break;
             case 0x55: // FX55: Store V[0] to V[X] in memory starting at location I.
             {
-                if (!isValidMemoryAddress(I) || !isValidMemoryAddress(I + VX)) {
-                    cerr << "Error: FX55 attempting to write to invalid memory address range starting at 0x" << hex << I << dec << endl;
+                if (CHECKED && (!isValidMemoryAddress(I) || !isValidMemoryAddress(I + VX))) {
+                    if (reportsErrors()) {
+                        cerr << "Error: FX55 attempting to write to invalid memory address range starting at 0x" << hex << I << dec << endl;
+                    }
                     rom_loaded = false;
                     break;
                 }
     
                 for (int i = 0; i <= VX; ++i) {
-                    memory[I + i] = V[i];
+                    writeMemory(I + i, V[i]);
+                }
+                onMemoryWrite(I, VX + 1);
+                if (quirks & QUIRK_LOAD_STORE_INC_I) {
+                    I += VX + 1;
                 }
-                //I += VX + 1; // classic behaviour
                 incPC();
             }
         break;
         case 0x65: // FX65: Read V[0] to V[X] from memory starting at location I.
         {
-            if (!isValidMemoryAddress(I) || !isValidMemoryAddress(I + VX)) {
-                cerr << "Error: FX65 attempting to read from invalid memory address range starting at 0x" << hex << I << dec << endl;
+            if (CHECKED && (!isValidMemoryAddress(I) || !isValidMemoryAddress(I + VX))) {
+                if (reportsErrors()) {
+                    cerr << "Error: FX65 attempting to read from invalid memory address range starting at 0x" << hex << I << dec << endl;
+                }
                 rom_loaded = false;
                 break;
             }
        
             for (int i = 0; i <= VX; ++i) {
-                V[i] = memory[I + i];
+                V[i] = readMemory(I + i);
             }
 
-            //I += VX + 1; // classic behaviour
+            if (quirks & QUIRK_LOAD_STORE_INC_I) {
+                I += VX + 1;
+            }
             incPC();
         }
         break;
         default:
-            cout << "Could not find opcode! Nibble: F Opcode: 0x" << hex << opcode << dec << endl;
+            if (reportsErrors()) {
+                cout << "Could not find opcode! Nibble: F Opcode: 0x" << hex << opcode << dec << endl;
+            }
             incPC();
             break;
         }
@@ -563,8 +1038,10 @@ void CHIP8::execute_opcode() {
             incPC();
             break;
         case 0x00EE: // 0x00EE (return from subroutine)
-            if (sp == 0) {
-                cerr << "Error: Stack underflow on return instruction" << endl;
+            if (CHECKED && sp == 0) {
+                if (reportsErrors()) {
+                    cerr << "Error: Stack underflow on return instruction" << endl;
+                }
                 rom_loaded = false;
                 break;
             }
@@ -574,7 +1051,9 @@ void CHIP8::execute_opcode() {
             incPC();
             break;
       default:
-            cout << "Unknown opcode: 0x" << hex << opcode << dec << endl;
+            if (reportsErrors()) {
+                cout << "Unknown opcode: 0x" << hex << opcode << dec << endl;
+            }
             incPC();
             break;
         }
@@ -604,6 +1083,10 @@ void CHIP8::run() {
         return;
     }
     
+    if (catalog) {
+        SDL_SetWindowTitle(window, ("CHIP-8 Emulator - " + catalog->at(catalog_index).name).c_str());
+    }
+    
     // Create renderer
     SDL_Renderer* renderer = SDL_CreateRenderer(window, NULL);
     if (renderer == NULL) {
@@ -633,81 +1116,143 @@ void CHIP8::run() {
     bool running = true;
     SDL_Event event;
     
-    // Gets current time with highest precision available
-    // Auto automatically assigns the variable type
-    last_cycle_time = high_resolution_clock::now();
-    last_timer_update = high_resolution_clock::now();
-    auto last_render_time = high_resolution_clock::now();
+    // Run-ahead display and its smoothed cost, shown by the F1 overlay
+    uint64_t ahead_display[32];
+    double run_ahead_ms = 0.0;
+    bool show_overlay = false;
+    
+    // Frame deadlines in SDL's nanosecond clock, the same clock key events are stamped with
+    uint64_t next_frame_ns = SDL_GetTicksNS() + FRAME_NS;
+    if (!input_queue) {
+        input_queue = make_unique<InputQueue>();
+    }
+    uint64_t input_window_start_ns = SDL_GetTicksNS();
+    
+    // Once a second the instruction rate and idle ratio are worked out from these
+    uint64_t stats_start_ns = SDL_GetTicksNS();
+    uint64_t stats_start_cycle = cycle_count;
+    uint64_t stats_idle_ns = 0;
     
     pc = PROGRAM_START;
     sp = 0;
     
     while (running && rom_loaded) {
-      // Handle SDL events
+        uint64_t frame_start_ns = SDL_GetTicksNS();
+        
+        // Handle SDL events once per frame. Key events are queued against the window they were collected over.
+        uint64_t poll_ns = SDL_GetTicksNS();
+        input_queue->setWindow(input_window_start_ns, poll_ns);
         while (SDL_PollEvent(&event)) {
             if (event.type == SDL_EVENT_QUIT) {
                 running = false;
             }
+            else if (event.type == SDL_EVENT_KEY_DOWN && event.key.scancode == SDL_SCANCODE_F5 && debugger) {
+                debugger->requestBreak(); // F5 breaks into the debugger
+            }
+            else if (event.type == SDL_EVENT_KEY_DOWN && event.key.scancode == SDL_SCANCODE_F1 && !event.key.repeat) {
+                show_overlay = !show_overlay;
+            }
+            else if (event.type == SDL_EVENT_KEY_DOWN && catalog && catalog->size() > 0
+                     && (event.key.scancode == SDL_SCANCODE_PAGEUP || event.key.scancode == SDL_SCANCODE_PAGEDOWN)) {
+                // Next or previous ROM in the library. Recently run ones are still cached and skip the analysis.
+                size_t count = catalog->size();
+                size_t next = (event.key.scancode == SDL_SCANCODE_PAGEDOWN) ? (catalog_index + 1) % count : (catalog_index + count - 1) % count;
+                if (loadFromCatalog(*catalog, next)) {
+                    SDL_SetWindowTitle(window, ("CHIP-8 Emulator - " + catalog->at(next).name).c_str());
+                }
+            }
             else if (event.type == SDL_EVENT_KEY_DOWN || event.type == SDL_EVENT_KEY_UP) {
                 handleKeyEvent(event.key);
             }
         }
-        
-        // Update timers
-        updateTimers();
+        input_window_start_ns = poll_ns;
      
-        // Fetch, Decode, Execute
-        execute_opcode();
+        // Fetch, Decode, Execute one frame of instructions
+        runFrame();
         
-        // Render screen every ~16.67ms (60 FPS)
-        auto current_render_time = high_resolution_clock::now();
-        auto render_elapsed = duration_cast<milliseconds>(current_render_time - last_render_time).count();
+        // Show the future frame when running ahead. Traps would fire inside the speculative frames, so not while debugging.
+        const uint64_t* shown_display = display;
+        if (run_ahead_frames > 0 && !debugger) {
+            auto ahead_start = high_resolution_clock::now();
+            runAhead(ahead_display);
+            shown_display = ahead_display;
+            double ahead_ms = duration<double, milli>(high_resolution_clock::now() - ahead_start).count();
+            run_ahead_ms = run_ahead_ms * 0.9 + ahead_ms * 0.1;
+        }
         
         // Main display updater. Locks texture, applies changes, then unlocks texture and updates screen
-        if (render_elapsed >= (1000 / 60)) {
-            // Lock texture
-            void* pixels_ptr = nullptr;
-            int pitch = 0;
-            int lockResult = SDL_LockTexture(texture, NULL, &pixels_ptr, &pitch); // Locks entire screen and returns updated pitch and pixels_ptr
-            
-            if (lockResult != 0) {
-                uint32_t* texture_pixels = static_cast<uint32_t*>(pixels_ptr);
-       
-                // Render display
-                for (int y = 0; y < 32; y++) {
-                    for (int x = 0; x < 64; x++) {
-                        // Gets each line of the updated display and checks each bit if its on or off
-                        uint64_t line = display[y];
-                        int bit_position = 63 - x;
-                        uint64_t bit = (line >> bit_position) & 1;
-      
-                        int pixel_offset = y * (pitch / sizeof(uint32_t)) + x;
-                        texture_pixels[pixel_offset] = bit ? PIXEL_ON : PIXEL_OFF;
-                    }
+        uint64_t render_start_ns = SDL_GetTicksNS();
+        void* pixels_ptr = nullptr;
+        int pitch = 0;
+        int lockResult = SDL_LockTexture(texture, NULL, &pixels_ptr, &pitch); // Locks entire screen and returns updated pitch and pixels_ptr
+        
+        if (lockResult != 0) {
+            uint32_t* texture_pixels = static_cast<uint32_t*>(pixels_ptr);
+   
+            // Render display
+            for (int y = 0; y < 32; y++) {
+                for (int x = 0; x < 64; x++) {
+                    // Gets each line of the updated display and checks each bit if its on or off
+                    uint64_t line = shown_display[y];
+                    int bit_position = 63 - x;
+                    uint64_t bit = (line >> bit_position) & 1;
+  
+                    int pixel_offset = y * (pitch / sizeof(uint32_t)) + x;
+                    texture_pixels[pixel_offset] = bit ? PIXEL_ON : PIXEL_OFF;
                 }
             }
+        }
    
-            SDL_UnlockTexture(texture);
-     
-            SDL_SetRenderDrawColor(renderer, 255, 255, 255, 255);
-            SDL_RenderClear(renderer);
-            SDL_RenderTexture(renderer, texture, nullptr, nullptr);
-            SDL_RenderPresent(renderer);
-     
-            last_render_time = current_render_time;
-
-            
+        SDL_UnlockTexture(texture);
+ 
+        SDL_SetRenderDrawColor(renderer, 255, 255, 255, 255);
+        SDL_RenderClear(renderer);
+        SDL_RenderTexture(renderer, texture, nullptr, nullptr);
+        
+        if (show_overlay) {
+            char overlay[96];
+            SDL_SetRenderDrawColor(renderer, 255, 255, 0, 255);
+            snprintf(overlay, sizeof(overlay), "%.0f IPS  frame %.2f ms  idle %.0f%%",
+                     instructions_per_second.value(), frame_seconds.mean() * 1000.0, idle_ratio.value() * 100.0);
+            SDL_RenderDebugText(renderer, 4, 4, overlay);
+            snprintf(overlay, sizeof(overlay), "render %.2f ms  missed %llu  dropped %llu",
+                     render_seconds.mean() * 1000.0, (unsigned long long)missed_deadlines_total.value(), (unsigned long long)dropped_input_total.value());
+            SDL_RenderDebugText(renderer, 4, 14, overlay);
+            snprintf(overlay, sizeof(overlay), "Run-ahead %d: +%.2f ms/frame (%.1f%% CPU)",
+                     run_ahead_frames, run_ahead_ms, run_ahead_ms * 100.0 / (1000.0 / 60));
+            SDL_RenderDebugText(renderer, 4, 24, overlay);
         }
+        SDL_RenderPresent(renderer);
+        render_seconds.observeNS(SDL_GetTicksNS() - render_start_ns);
       
-        // Maintain clock speed by only executing one cpu instruction every 1 ms
-        auto current_time = high_resolution_clock::now();
-        auto elapsed = duration_cast<microseconds>(current_time - last_cycle_time).count();
-        int desired_cycle_time_us = (500000 / CLOCK_SPEED); // Should be 1000000 but 500000 felt better for me. Adjust as needed
-  
-        if (elapsed < desired_cycle_time_us) {
-            SDL_Delay((desired_cycle_time_us - elapsed) / 1000); // Delays to ensure each instruction is executed every 1 ms.
+        // Sleep until the next frame is due. Events that arrive meanwhile keep their timestamps.
+        uint64_t now_ns = SDL_GetTicksNS();
+        if (now_ns < next_frame_ns) {
+            SDL_DelayNS(next_frame_ns - now_ns);
+            uint64_t woke_ns = SDL_GetTicksNS();
+            stats_idle_ns += woke_ns - now_ns;
+            sleep_overshoot_seconds.observeNS(woke_ns > next_frame_ns ? woke_ns - next_frame_ns : 0);
+        }
+        else {
+            missed_deadlines_total.add();
+        }
+        next_frame_ns += FRAME_NS;
+        
+        // After a long stall (e.g. stopped in the debugger) start over instead of racing to catch up
+        now_ns = SDL_GetTicksNS();
+        if (now_ns > next_frame_ns + FRAME_NS) {
+            next_frame_ns = now_ns + FRAME_NS;
+        }
+        frame_seconds.observeNS(now_ns - frame_start_ns);
+        
+        if (now_ns - stats_start_ns >= 1000000000ull) {
+            double window_ns = static_cast<double>(now_ns - stats_start_ns);
+            instructions_per_second.set((cycle_count - stats_start_cycle) * 1e9 / window_ns);
+            idle_ratio.set(stats_idle_ns / window_ns);
+            stats_start_ns = now_ns;
+            stats_start_cycle = cycle_count;
+            stats_idle_ns = 0;
         }
-        last_cycle_time = high_resolution_clock::now();
     }
     
     // Clean up SDL resources
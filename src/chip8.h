@@ -1,13 +1,20 @@
 #pragma once // Ensures this header file is included only once
 
 #include <cstdint>
+#include <bitset>
 #include <chrono>
 #include <SDL3/SDL.h>
-#include <fstream>
-#include <sstream>
+#include <memory>
 #include <string>
+#include <vector>
+#include "input_queue.h"
+#include "rom_catalog.h"
+
+class Debugger;
 
 class CHIP8 {
+    friend class Debugger;
+
 private:
     // CHIP-8 Memory and Registers
     static constexpr uint16_t MEMORY_SIZE = 4096;
@@ -21,10 +28,20 @@ private:
     // Clock and Timer Speeds
     static constexpr int CLOCK_SPEED = 650;
     static constexpr int TIMER_SPEED = 60;
+    static constexpr int CYCLES_PER_FRAME = (2 * CLOCK_SPEED) / TIMER_SPEED; // Default, ROM profiles can change it
+    static constexpr int MAX_RUN_AHEAD = 8;
+    static constexpr uint64_t FRAME_NS = 1000000000ull / TIMER_SPEED;
     static constexpr bool DEBUG_OPCODES = false;
+    static constexpr uint32_t RNG_SEED = 0x2545F491; // Any nonzero value
+
+    // Memory pages. Pages point into the shared image until the ROM writes to them.
+    static constexpr int PAGE_SHIFT = 7;
+    static constexpr uint16_t PAGE_SIZE = 1 << PAGE_SHIFT; // 128 bytes
+    static constexpr int PAGE_COUNT = MEMORY_SIZE / PAGE_SIZE;
 
     // Memory and Registers
-    uint8_t memory[MEMORY_SIZE];// 4KB memory
+    const uint8_t* pages[PAGE_COUNT]; // 4KB memory, split into pages
+    uint32_t owned_pages;       // Bit per page copied out of the shared image
     uint8_t V[16];              // V0-VF (VF is flag register)
     uint16_t I;                 // Index register
     uint16_t pc;                // Program counter
@@ -35,51 +52,105 @@ private:
     uint8_t key[16];            // Keypad state
     uint64_t display[32];       // Display buffer (64x32 pixels)
     uint16_t opcode;            // Current opcode
+    uint32_t rng_state;         // CXNN random number generator, part of the state so runs can be replayed
 
-    // Font data
-    static constexpr uint8_t chip8_fontset[80] = {
-        0xF0, 0x90, 0x90, 0x90, 0xF0, // 0
-        0x20, 0x60, 0x20, 0x20, 0x70, // 1
-        0xF0, 0x10, 0xF0, 0x80, 0xF0, // 2
-        0xF0, 0x10, 0xF0, 0x10, 0xF0, // 3
-        0x90, 0x90, 0xF0, 0x10, 0x10, // 4
-        0xF0, 0x80, 0xF0, 0x10, 0xF0, // 5
-        0xF0, 0x80, 0xF0, 0x90, 0xF0, // 6
-        0xF0, 0x10, 0x20, 0x40, 0x40, // 7
-        0xF0, 0x90, 0xF0, 0x90, 0xF0, // 8
-        0xF0, 0x90, 0xF0, 0x10, 0xF0, // 9
-        0xF0, 0x90, 0xF0, 0x90, 0x90, // A
-        0xE0, 0x90, 0xE0, 0x90, 0xE0, // B
-        0xF0, 0x80, 0x80, 0x80, 0xF0, // C
-        0xE0, 0x90, 0x90, 0x90, 0xE0, // D
-        0xF0, 0x80, 0xF0, 0x80, 0xF0, // E
-        0xF0, 0x80, 0xF0, 0x80, 0x80  // F
+    // Default keyboard layout for CHIP-8 keys 0 to F
+    static constexpr uint16_t DEFAULT_KEYMAP[16] = {
+        SDL_SCANCODE_X, SDL_SCANCODE_1, SDL_SCANCODE_2, SDL_SCANCODE_3, // 0 1 2 3
+        SDL_SCANCODE_Q, SDL_SCANCODE_W, SDL_SCANCODE_E, SDL_SCANCODE_A, // 4 5 6 7
+        SDL_SCANCODE_S, SDL_SCANCODE_D, SDL_SCANCODE_Z, SDL_SCANCODE_C, // 8 9 A B
+        SDL_SCANCODE_4, SDL_SCANCODE_R, SDL_SCANCODE_F, SDL_SCANCODE_V  // C D E F
     };
 
-    // Timing
-    std::chrono::high_resolution_clock::time_point last_cycle_time;
-    std::chrono::high_resolution_clock::time_point last_timer_update;
-
     // ROM loaded flag
     bool rom_loaded;
 
-    // Logging members
-    std::ofstream log_file;
-    std::string log_directory;
-    std::string log_filename;
+    // Every address maps to the handler that executes the instruction stored there,
+    // so the debugger can patch a single entry with trapHandler instead of checking every fetch.
+    using OpHandler = void (CHIP8::*)();
+
+    // Immutable memory image shared by every instance running the same ROM: fontset and ROM bytes,
+    // the analysis results and the dispatch table built from them.
+    struct SharedImage {
+        uint8_t memory[MEMORY_SIZE];
+        std::bitset<MEMORY_SIZE> unchecked;     // Instructions whose bounds checks are proven to pass
+        std::bitset<MEMORY_SIZE> analyzed_code; // Bytes the analysis decoded as instructions
+        OpHandler dispatch[MEMORY_SIZE];
+        ROMProfile profile;                     // Per-ROM settings
+        int8_t keymap[SDL_SCANCODE_COUNT];      // Scancode -> CHIP-8 key, -1 for none
+    };
+    std::shared_ptr<const SharedImage> image;
+
+    // Dispatch table in use: the image's, the font image's all checked one once the proofs are dropped,
+    // or a private copy once the debugger patches an entry.
+    const OpHandler* dispatch;
+    std::unique_ptr<OpHandler[]> private_dispatch;
+    bool unchecked_allowed;     // Cleared when a write into analyzed code invalidates the proofs
+    Debugger* debugger;
+
+    // Run-ahead: frames emulated past the present one before each render (per-ROM setting)
+    int run_ahead_frames;
+    bool speculating;           // Set while runAhead executes frames that will be rolled back
+    bool quiet;                 // Set by tools that run many instances and expect ROMs to crash
+
+    // Per-ROM profile, copied out of the image for the hot paths
+    uint8_t quirks;
+    int cycles_per_frame;
+
+    // ROM library used to switch ROMs with PageUp/PageDown. The images of the last few library ROMs are
+    // held here, most recent first, so switching back to one finds it in the image cache.
+    static constexpr int RECENT_IMAGES = 8;
+    const ROMCatalog* catalog;
+    size_t catalog_index;
+    std::vector<std::shared_ptr<const SharedImage>> recent_images;
+
+    // Input. Key events carry their SDL timestamp, are converted to the cycle they happened on and
+    // applied by runFrame when execution reaches that cycle. The queue is only allocated once input arrives.
+    std::unique_ptr<InputQueue> input_queue;
+    uint64_t next_input_cycle;  // Cycle of the oldest queued event, cached for the per-instruction test
+    uint64_t cycle_count;       // Instructions executed since start
+    uint64_t frame_end_cycle;   // Cycle the running frame ends on. Debugger steps move it when they cross it.
+
+    // Cached hashes of owned pages for stateHash(). A write clears the page's bit.
+    uint32_t hashed_pages;
+    std::unique_ptr<uint64_t[]> page_hashes;
+
+    // Memory access
+    uint8_t readMemory(uint16_t address) const { return pages[address >> PAGE_SHIFT][address & (PAGE_SIZE - 1)]; }
+    void writeMemory(uint16_t address, uint8_t value);
+    void copyPage(int page);
+    void releasePages();
 
     // Opcode execution methods
     void execute_opcode();
+    template <bool CHECKED> void executeInstruction();
+    void decodeAndExecute();
+    void decodeAndExecuteUnchecked();
+    void trapHandler();
+    OpHandler baseHandler(uint16_t address);
+    OpHandler* writableDispatch();
+    void onMemoryWrite(uint16_t address, uint16_t length);
+    void attachImage(const std::shared_ptr<const SharedImage>& new_image);
+    void dropUncheckedHandlers();
+    void restoreUncheckedHandlers();
+    bool reportsErrors() const { return !speculating && !quiet; } // Error and warning output from instructions
     void incPC();
     void logOpcode(uint16_t op);
-    void updateTimers();
+    void tickTimers();
+    void runAhead(uint64_t* ahead_display);
+    void applyQueuedInput();
+    void stepCycle();
+    void reset();
     int genRandomNum(); // For CXNN
 
-    // Logging methods
-    void initializeLogging();
-    void writeToLog(const std::string& message);
-    std::string getCurrentTimestamp();
-    bool createDirectory(const std::string& path);
+    // Shared images
+    static std::shared_ptr<const SharedImage> fontImage();
+    static std::shared_ptr<const SharedImage> loadImage(const std::string& filename, const ROMProfile& profile);
+    static void analyzeImage(SharedImage& new_image);
+    static void buildKeymap(SharedImage& new_image);
+
+    // Logging goes to the process wide Logger
+    static void writeToLog(const std::string& message);
     
     // Validation helpers
     bool isValidMemoryAddress(uint16_t address);
@@ -87,16 +158,55 @@ private:
     bool isValidKeyIndex(uint8_t key_index);
 
 public:
+    // Full machine state, used to save and roll back the emulator. Only pages this instance has
+    // written to are stored; the rest still match the shared image.
+    struct Snapshot {
+        uint8_t pages[PAGE_COUNT][PAGE_SIZE];
+        uint32_t owned_pages;
+        uint8_t V[16];
+        uint16_t I;
+        uint16_t pc;
+        uint16_t stack[STACK_SIZE];
+        int sp;
+        uint8_t delay_timer;
+        uint8_t sound_timer;
+        uint8_t key[16];
+        uint64_t display[32];
+        uint16_t opcode;
+        uint32_t rng_state;
+        bool rom_loaded;
+        bool unchecked_allowed;
+        uint32_t hashed_pages;
+        uint64_t page_hashes[PAGE_COUNT];
+    };
+
     // Constructor and Destructor
     CHIP8();
     ~CHIP8();
+    CHIP8(const CHIP8&) = delete;
+    CHIP8& operator=(const CHIP8&) = delete;
     
     // Public interface
-    bool loadROM(const char* filename);
+    bool loadROM(const char* filename); // Settings come from "<filename>.cfg"
+    bool loadROM(const char* filename, const ROMProfile& profile);
+    bool loadFromCatalog(const ROMCatalog& rom_catalog, size_t index);
     void run();
+    void runFrame();
     void handleKeyEvent(SDL_KeyboardEvent key_event);
+    void attachDebugger(Debugger* dbg) { debugger = dbg; }
+    void saveState(Snapshot& state) const;
+    void loadState(const Snapshot& state);
+    void setRunAhead(int frames);
+
+    // Used by tools that drive the emulator without SDL
+    bool runFrameUntil(uint16_t address); // runFrame that stops when pc reaches address. Returns true if it did.
+    void setKeys(uint16_t mask);          // Bit n set holds key n down
+    void setQuiet(bool silent) { quiet = silent; } // Stops instructions printing errors and warnings
+    uint64_t stateHash();                 // Hash of memory, registers, stack, timers and display
     
     // Getters for display and state
     const uint64_t* getDisplay() const { return display; }
     bool isRunning() const { return rom_loaded; }
+    uint16_t getPC() const { return pc; }
+    uint8_t getMemory(uint16_t address) const { return readMemory(address); }
 };
@@ -0,0 +1,103 @@
+#include "analyzer.h"
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+// Standalone disassembler and control flow graph dump built on ROMAnalyzer.
+// Usage: chip8dis <rom.ch8> [--dot] [--inc-i]
+int main(int argc, char* argv[]) {
+    if (argc < 2) {
+        cerr << "Usage: " << argv[0] << " <rom.ch8> [--dot] [--inc-i]" << endl;
+        return 1;
+    }
+    bool dot = false;
+    bool inc_i = false; // Analyze with the FX55/FX65 increment quirk
+    for (int i = 2; i < argc; ++i) {
+        string arg = argv[i];
+        if (arg == "--dot") {
+            dot = true;
+        }
+        else if (arg == "--inc-i") {
+            inc_i = true;
+        }
+        else {
+            cerr << "Error: Unknown option: " << arg << endl;
+            return 1;
+        }
+    }
+
+    // Same checks and memory layout as the emulator, so the listing matches what it runs
+    ifstream ROM(argv[1], ios::binary | ios::ate);
+    if (!ROM.is_open()) {
+        cerr << "Error: Could not open ROM file: " << argv[1] << endl;
+        return 1;
+    }
+    size_t rom_bytes = (size_t)ROM.tellg();
+    if (rom_bytes == 0) {
+        cerr << "Error: ROM file is empty!" << endl;
+        return 1;
+    }
+    if (rom_bytes > ROMAnalyzer::MAX_ROM_SIZE) {
+        cerr << "Error: ROM File Size (" << rom_bytes << " bytes) is too big! Max size: " << ROMAnalyzer::MAX_ROM_SIZE << " bytes" << endl;
+        return 1;
+    }
+    vector<uint8_t> rom(rom_bytes);
+    ROM.seekg(0);
+    ROM.read(reinterpret_cast<char*>(rom.data()), rom_bytes);
+
+    static uint8_t memory[ROMAnalyzer::MEMORY_SIZE];
+    ROMAnalyzer::layoutImage(rom.data(), rom_bytes, memory);
+
+    ROMAnalyzer analyzer(memory, inc_i);
+    analyzer.analyze();
+
+    if (dot) {
+        // Graphviz output, one node per basic block
+        cout << "digraph cfg {" << endl;
+        cout << "    node [shape=box, fontname=monospace];" << endl;
+        for (const ROMAnalyzer::BasicBlock& block : analyzer.getBlocks()) {
+            printf("    b%03X [label=\"", block.start);
+            for (uint16_t address = block.start; address < block.end; address += 2) {
+                printf("%03X  %s\\l", address, ROMAnalyzer::disassemble(analyzer.opcodeAt(address)).c_str());
+            }
+            printf("\"];\n");
+            for (uint16_t next : block.successors) {
+                printf("    b%03X -> b%03X;\n", block.start, next);
+            }
+        }
+        cout << "}" << endl;
+        return 0;
+    }
+
+    // Listing. Instructions that keep their bounds checks are marked with '!'.
+    int reachable_count = 0;
+    int safe_count = 0;
+    for (const ROMAnalyzer::BasicBlock& block : analyzer.getBlocks()) {
+        ROMAnalyzer::Range i = analyzer.iRangeAt(block.start);
+        ROMAnalyzer::Range d = analyzer.stackDepthAt(block.start);
+        printf("block %03X-%03X  I=[%03X,%03X] depth=[%d,%d]  ->", block.start, block.end - 2, i.lo, i.hi, d.lo, d.hi);
+        for (uint16_t next : block.successors) {
+            printf(" %03X", next);
+        }
+        printf("\n");
+
+        for (uint16_t address = block.start; address < block.end; address += 2) {
+            uint16_t op = analyzer.opcodeAt(address);
+            bool safe = analyzer.isSafe(address);
+            reachable_count++;
+            safe_count += safe ? 1 : 0;
+            printf("  %c %03X  %04X  %s\n", safe ? ' ' : '!', address, op, ROMAnalyzer::disassemble(op).c_str());
+        }
+        printf("\n");
+    }
+
+    printf("%zu blocks, %d reachable instructions, %d run unchecked\n", analyzer.getBlocks().size(), reachable_count, safe_count);
+    if (analyzer.hasIndirectJump()) {
+        printf("BNNN found: the graph is incomplete, bounds checks are kept everywhere\n");
+    }
+    return 0;
+}
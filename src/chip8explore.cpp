@@ -0,0 +1,75 @@
+#include "explorer.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <thread>
+
+using namespace std;
+using namespace chrono;
+
+// Searches for the shortest input movie that reaches a goal.
+// Usage: chip8explore <rom.ch8> <goal> [--threads N] [--frames N] [--max-states N]
+// The movie goes to stdout as "<frames> <key>" lines, key being 0-F or '-' for no key.
+int main(int argc, char* argv[]) {
+    if (argc < 3) {
+        cerr << "Usage: " << argv[0] << " <rom.ch8> <crash|pc:ADDR|mem:ADDR:VAL> [--threads N] [--frames N] [--max-states N]" << endl;
+        return 1;
+    }
+
+    StateExplorer::Goal goal;
+    if (!StateExplorer::parseGoal(argv[2], goal)) {
+        cerr << "Error: Invalid goal: " << argv[2] << endl;
+        return 1;
+    }
+
+    int threads = max(1u, thread::hardware_concurrency());
+    int max_frames = 600;
+    size_t max_states = 1000000;
+    for (int i = 3; i + 1 < argc; i += 2) {
+        string arg = argv[i];
+        if (arg == "--threads") {
+            threads = atoi(argv[i + 1]);
+        }
+        else if (arg == "--frames") {
+            max_frames = atoi(argv[i + 1]);
+        }
+        else if (arg == "--max-states") {
+            max_states = strtoull(argv[i + 1], nullptr, 10);
+        }
+        else {
+            cerr << "Error: Unknown option: " << arg << endl;
+            return 1;
+        }
+    }
+
+    StateExplorer explorer(argv[1], goal, threads, max_frames, max_states);
+    auto start = steady_clock::now();
+    bool reached = explorer.explore();
+    double seconds = duration<double>(steady_clock::now() - start).count();
+
+    fprintf(stderr, "%zu states, %d frames deep, %.2f s\n", explorer.statesVisited(), explorer.framesSearched(), seconds);
+    if (!reached) {
+        cerr << "Goal not reached" << endl;
+        return 2;
+    }
+
+    // Run length encoded movie
+    const vector<int8_t>& movie = explorer.getMovie();
+    fprintf(stderr, "Goal reached after %zu frames\n", movie.size());
+    for (size_t i = 0; i < movie.size();) {
+        size_t run = 1;
+        while (i + run < movie.size() && movie[i + run] == movie[i]) {
+            run++;
+        }
+        if (movie[i] == StateExplorer::NO_KEY) {
+            printf("%zu -\n", run);
+        }
+        else {
+            printf("%zu %X\n", run, movie[i]);
+        }
+        i += run;
+    }
+    return 0;
+}
@@ -0,0 +1,320 @@
+#include "debugger.h"
+#include "chip8.h"
+#include "analyzer.h"
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+
+using namespace std;
+
+// Constructor
+Debugger::Debugger(CHIP8& emulator) : emu(emulator) {
+    emu.attachDebugger(this);
+}
+
+// Destructor. Restores every patched dispatch entry before detaching.
+Debugger::~Debugger() {
+    for (const auto& bp : breakpoints) {
+        removeTrap(bp.first);
+    }
+    emu.attachDebugger(nullptr);
+}
+
+// Patches the dispatch entry for address with the trap handler
+void Debugger::insertTrap(uint16_t address) {
+    emu.writableDispatch()[address] = &CHIP8::trapHandler;
+}
+
+// Puts the normal handler back
+void Debugger::removeTrap(uint16_t address) {
+    emu.writableDispatch()[address] = emu.baseHandler(address);
+}
+
+void Debugger::addBreakpoint(uint16_t address, bool temporary) {
+    if (address >= CHIP8::MEMORY_SIZE) {
+        cout << "Error: Breakpoint address out of range (0x" << hex << address << dec << ")" << endl;
+        return;
+    }
+
+    auto it = breakpoints.find(address);
+    if (it != breakpoints.end()) {
+        it->second = it->second && temporary; // A permanent breakpoint stays permanent
+        return;
+    }
+
+    breakpoints[address] = temporary;
+    insertTrap(address);
+}
+
+// Patches every breakpoint back in after the emulator switched to a new image
+void Debugger::reinsertTraps() {
+    for (const auto& bp : breakpoints) {
+        insertTrap(bp.first);
+    }
+}
+
+void Debugger::removeBreakpoint(uint16_t address) {
+    if (breakpoints.erase(address) > 0) {
+        removeTrap(address);
+    }
+}
+
+void Debugger::addWatchpoint(uint16_t start, uint16_t length) {
+    if (length == 0 || start >= CHIP8::MEMORY_SIZE) {
+        cout << "Error: Invalid watchpoint range" << endl;
+        return;
+    }
+    watchpoints.push_back({ start, length });
+}
+
+void Debugger::removeWatchpoint(uint16_t start) {
+    for (auto it = watchpoints.begin(); it != watchpoints.end(); ++it) {
+        if (it->start == start) {
+            watchpoints.erase(it);
+            return;
+        }
+    }
+}
+
+// Asynchronous break (F5 in the emulator window). Traps on the instruction at pc.
+void Debugger::requestBreak() {
+    addBreakpoint(emu.pc, true);
+}
+
+// Called by FX33/FX55 after they write to memory. Stops once the writing instruction has finished.
+void Debugger::onMemoryWrite(uint16_t address, uint16_t length) {
+    for (const Watchpoint& wp : watchpoints) {
+        if (address < wp.start + wp.length && wp.start < address + length) {
+            cout << "Watchpoint 0x" << hex << setfill('0') << setw(3) << wp.start
+                 << ": write to 0x" << setw(3) << address << " (" << dec << length << " bytes) by instruction at 0x"
+                 << hex << setw(3) << emu.pc << dec << setfill(' ') << endl;
+            addBreakpoint(emu.pc + 2, true); // FX33 and FX55 always fall through to the next instruction
+            return;
+        }
+    }
+}
+
+// Entered from CHIP8::trapHandler before the instruction at pc runs
+void Debugger::onTrap() {
+    auto it = breakpoints.find(emu.pc);
+    if (it != breakpoints.end() && it->second) {
+        removeBreakpoint(emu.pc);
+    }
+
+    cout << "Stopped at ";
+    printLocation();
+
+    string line;
+    while (emu.rom_loaded) {
+        cout << "(chip8) " << flush;
+        if (!getline(cin, line)) {
+            // Input closed: drop every trap and let the ROM run freely
+            for (const auto& bp : breakpoints) {
+                removeTrap(bp.first);
+            }
+            breakpoints.clear();
+            watchpoints.clear();
+            emu.decodeAndExecute();
+            return;
+        }
+        if (executeCommand(line)) {
+            return;
+        }
+    }
+}
+
+// Runs a single command. Commands that resume execution first step over the instruction at pc,
+// since its dispatch entry may be the trap that brought us here.
+bool Debugger::executeCommand(const string& line) {
+    istringstream in(line);
+    string command, arg1, arg2;
+    in >> command >> arg1 >> arg2;
+    uint16_t address = 0;
+    uint16_t length = 0;
+
+    if (command.empty()) {
+        return false;
+    }
+    else if (command == "c" || command == "continue") {
+        emu.decodeAndExecute();
+        return true;
+    }
+    else if (command == "s" || command == "step") {
+        stepInstruction();
+        printLocation();
+    }
+    else if (command == "n" || command == "next") { // Step over 2NNN calls
+        bool is_call = emu.isValidMemoryAddress(emu.pc + 1) && (emu.readMemory(emu.pc) >> 4) == 2;
+        if (is_call) {
+            addBreakpoint(emu.pc + 2, true);
+            emu.decodeAndExecute();
+            return true;
+        }
+        stepInstruction();
+        printLocation();
+    }
+    else if (command == "u" || command == "until") { // Run to address
+        if (!parseAddress(arg1, address)) {
+            cout << "Error: Usage: until ADDR" << endl;
+            return false;
+        }
+        addBreakpoint(address, true);
+        emu.decodeAndExecute();
+        return true;
+    }
+    else if (command == "b" || command == "break") {
+        if (!parseAddress(arg1, address)) {
+            cout << "Error: Usage: break ADDR" << endl;
+            return false;
+        }
+        addBreakpoint(address);
+    }
+    else if (command == "d" || command == "delete") {
+        if (!parseAddress(arg1, address)) {
+            cout << "Error: Usage: delete ADDR" << endl;
+            return false;
+        }
+        removeBreakpoint(address);
+    }
+    else if (command == "w" || command == "watch") {
+        if (!parseAddress(arg1, address)) {
+            cout << "Error: Usage: watch ADDR [LEN]" << endl;
+            return false;
+        }
+        length = 1;
+        if (!arg2.empty() && !parseAddress(arg2, length)) {
+            cout << "Error: Invalid length" << endl;
+            return false;
+        }
+        addWatchpoint(address, length);
+    }
+    else if (command == "uw" || command == "unwatch") {
+        if (!parseAddress(arg1, address)) {
+            cout << "Error: Usage: unwatch ADDR" << endl;
+            return false;
+        }
+        removeWatchpoint(address);
+    }
+    else if (command == "r" || command == "regs") {
+        printRegisters();
+    }
+    else if (command == "x" || command == "mem") {
+        if (!parseAddress(arg1, address)) {
+            cout << "Error: Usage: mem ADDR [LEN]" << endl;
+            return false;
+        }
+        length = 16;
+        if (!arg2.empty() && !parseAddress(arg2, length)) {
+            cout << "Error: Invalid length" << endl;
+            return false;
+        }
+        printMemory(address, length);
+    }
+    else if (command == "l" || command == "list") {
+        printBreakpoints();
+    }
+    else if (command == "q" || command == "quit") {
+        emu.rom_loaded = false;
+        return true;
+    }
+    else if (command == "h" || command == "help") {
+        printHelp();
+    }
+    else {
+        cout << "Error: Unknown command: " << command << endl;
+    }
+    return false;
+}
+
+// Executes the instruction at pc without going through the dispatch table. Emulated time moves on as it
+// would in runFrame: the cycle count, queued input and the timers at frame boundaries.
+void Debugger::stepInstruction() {
+    if (!emu.isValidMemoryAddress(emu.pc) || !emu.isValidMemoryAddress(emu.pc + 1)) {
+        cout << "Error: Program counter out of bounds (0x" << hex << emu.pc << dec << ")" << endl;
+        emu.rom_loaded = false;
+        return;
+    }
+    emu.stepCycle();
+}
+
+void Debugger::printHelp() {
+    cout << "Commands (addresses and lengths are hex):" << endl
+         << "  c, continue        resume execution" << endl
+         << "  s, step            execute one instruction" << endl
+         << "  n, next            step over 2NNN calls" << endl
+         << "  u, until ADDR      run to ADDR" << endl
+         << "  b, break ADDR      set breakpoint" << endl
+         << "  d, delete ADDR     remove breakpoint" << endl
+         << "  w, watch ADDR [LEN]  stop after FX33/FX55 writes to the range" << endl
+         << "  uw, unwatch ADDR   remove watchpoint" << endl
+         << "  r, regs            show registers" << endl
+         << "  x, mem ADDR [LEN]  dump memory" << endl
+         << "  l, list            list breakpoints and watchpoints" << endl
+         << "  q, quit            stop the emulator" << endl;
+}
+
+// Prints pc and the instruction stored there
+void Debugger::printLocation() {
+    if (!emu.isValidMemoryAddress(emu.pc) || !emu.isValidMemoryAddress(emu.pc + 1)) {
+        cout << "0x" << hex << emu.pc << dec << " (out of bounds)" << endl;
+        return;
+    }
+    uint16_t op = (emu.readMemory(emu.pc) << 8) | emu.readMemory(emu.pc + 1);
+    cout << "0x" << hex << setfill('0') << setw(3) << emu.pc << ": " << setw(4) << op << dec << setfill(' ')
+         << "  " << ROMAnalyzer::disassemble(op) << endl;
+}
+
+void Debugger::printRegisters() {
+    cout << hex << setfill('0');
+    for (int i = 0; i < 16; ++i) {
+        cout << "V" << uppercase << i << nouppercase << "=" << setw(2) << (int)emu.V[i] << ((i % 8 == 7) ? "\n" : " ");
+    }
+    cout << "I=" << setw(3) << emu.I << " PC=" << setw(3) << emu.pc << dec
+         << " SP=" << emu.sp << " DT=" << (int)emu.delay_timer << " ST=" << (int)emu.sound_timer << endl;
+    cout << "Stack:" << hex;
+    for (int i = 1; i <= emu.sp; ++i) {
+        cout << " " << setw(3) << emu.stack[i];
+    }
+    cout << dec << setfill(' ') << endl;
+}
+
+void Debugger::printMemory(uint16_t address, uint16_t length) {
+    cout << hex << setfill('0');
+    for (uint32_t i = 0; i < length && address + i < CHIP8::MEMORY_SIZE; ++i) {
+        if (i % 16 == 0) {
+            cout << (i ? "\n" : "") << setw(3) << (address + i) << ":";
+        }
+        cout << " " << setw(2) << (int)emu.readMemory(address + i);
+    }
+    cout << dec << setfill(' ') << endl;
+}
+
+void Debugger::printBreakpoints() {
+    cout << hex << setfill('0');
+    for (const auto& bp : breakpoints) {
+        cout << "break 0x" << setw(3) << bp.first << (bp.second ? " (temporary)" : "") << endl;
+    }
+    for (const Watchpoint& wp : watchpoints) {
+        cout << "watch 0x" << setw(3) << wp.start << " len " << wp.length << endl;
+    }
+    cout << dec << setfill(' ');
+}
+
+// Parses a hex number with or without the 0x prefix
+bool Debugger::parseAddress(const string& text, uint16_t& address) {
+    if (text.empty()) {
+        return false;
+    }
+    try {
+        size_t used = 0;
+        unsigned long value = stoul(text, &used, 16);
+        if (used != text.size() || value > 0xFFFF) {
+            return false;
+        }
+        address = static_cast<uint16_t>(value);
+        return true;
+    }
+    catch (const exception&) {
+        return false;
+    }
+}
@@ -0,0 +1,52 @@
+#pragma once // Ensures this header file is included only once
+
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+class CHIP8;
+
+// Interactive debugger driven by a line based text protocol on stdin.
+// Breakpoints patch the emulator's dispatch table with a trap, so code without breakpoints runs at full speed.
+class Debugger {
+private:
+    struct Watchpoint {
+        uint16_t start;
+        uint16_t length;
+    };
+
+    CHIP8& emu;
+    std::map<uint16_t, bool> breakpoints; // Address -> temporary (removed when hit)
+    std::vector<Watchpoint> watchpoints;
+
+    // Trap helpers
+    void insertTrap(uint16_t address);
+    void removeTrap(uint16_t address);
+
+    // Command handling
+    bool executeCommand(const std::string& line); // Returns true when execution should resume
+    void stepInstruction();
+    void printHelp();
+    void printLocation();
+    void printRegisters();
+    void printMemory(uint16_t address, uint16_t length);
+    void printBreakpoints();
+    bool parseAddress(const std::string& text, uint16_t& address);
+
+public:
+    Debugger(CHIP8& emulator);
+    ~Debugger();
+
+    // Breakpoints and watchpoints
+    void addBreakpoint(uint16_t address, bool temporary = false);
+    void removeBreakpoint(uint16_t address);
+    void addWatchpoint(uint16_t start, uint16_t length);
+    void removeWatchpoint(uint16_t start);
+    void requestBreak(); // Stops before the next instruction
+
+    // Called by the emulator
+    void onTrap();
+    void onMemoryWrite(uint16_t address, uint16_t length);
+    void reinsertTraps();
+};
@@ -0,0 +1,232 @@
+#include "explorer.h"
+#include <algorithm>
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <thread>
+
+using namespace std;
+
+static constexpr uint16_t NO_ADDRESS = 0xFFFF; // pc never gets here, used when the goal is not a pc
+
+// Constructor
+StateExplorer::StateExplorer(const string& rom_path, const Goal& goal, int threads, int max_frames, size_t max_states)
+    : rom_path(rom_path), goal(goal), thread_count(max(1, threads)), max_frames(max_frames), max_states(max_states),
+      queues(thread_count), visited_count(0), found(false), found_node({ 0, NO_KEY }), depth(0) {
+}
+
+bool StateExplorer::parseGoal(const string& text, Goal& goal) {
+    char* end = nullptr;
+    if (text == "crash") {
+        goal = { Goal::CRASH, 0, 0 };
+        return true;
+    }
+    if (text.compare(0, 3, "pc:") == 0) {
+        unsigned long address = strtoul(text.c_str() + 3, &end, 16);
+        if (*end != '\0' || end == text.c_str() + 3 || address > 0xFFF) {
+            return false;
+        }
+        goal = { Goal::PC, (uint16_t)address, 0 };
+        return true;
+    }
+    if (text.compare(0, 4, "mem:") == 0) {
+        unsigned long address = strtoul(text.c_str() + 4, &end, 16);
+        if (*end != ':' || end == text.c_str() + 4 || address > 0xFFF) {
+            return false;
+        }
+        const char* value_text = end + 1;
+        unsigned long value = strtoul(value_text, &end, 16);
+        if (*end != '\0' || end == value_text || value > 0xFF) {
+            return false;
+        }
+        goal = { Goal::MEMORY, (uint16_t)address, (uint8_t)value };
+        return true;
+    }
+    return false;
+}
+
+// Runs the search one frame deep at a time until the goal is reached or a limit is hit
+bool StateExplorer::explore() {
+    ROMProfile profile;
+    ROMCatalog::readProfile(rom_path, profile);
+    CHIP8 root;
+    if (!root.loadROM(rom_path.c_str(), profile)) {
+        cerr << "Error: Could not load ROM: " << rom_path << endl;
+        return false;
+    }
+
+    // One emulator per thread for the whole search, all sharing the ROM image. Branches are expected
+    // to crash, so they don't report errors.
+    vector<unique_ptr<CHIP8>> emulators;
+    for (int worker = 0; worker < thread_count; ++worker) {
+        emulators.push_back(make_unique<CHIP8>());
+        emulators.back()->loadROM(rom_path.c_str(), profile);
+        emulators.back()->setQuiet(true);
+    }
+
+    CHIP8::Snapshot state;
+    root.saveState(state);
+    markVisited(root.stateHash());
+    levels.assign(1, { { 0, NO_KEY } });
+    frontier.assign(1, {});
+    pack(state, frontier[0]);
+
+    while (depth < max_frames && !frontier.empty() && visited_count < max_states) {
+        for (uint32_t i = 0; i < frontier.size(); ++i) {
+            queues[i % thread_count].items.push_back(i);
+        }
+
+        // Every thread returns before the next level starts, which keeps the search breadth first
+        vector<Expansion> expansions(thread_count);
+        vector<thread> workers;
+        for (int worker = 0; worker < thread_count; ++worker) {
+            workers.emplace_back(&StateExplorer::expandLevel, this, worker, ref(*emulators[worker]), ref(expansions[worker]));
+        }
+        for (thread& worker : workers) {
+            worker.join();
+        }
+        depth++;
+
+        if (found) {
+            buildMovie();
+            return true;
+        }
+
+        vector<Node> next_level;
+        vector<vector<uint8_t>> next_frontier;
+        for (Expansion& expansion : expansions) {
+            next_level.insert(next_level.end(), expansion.nodes.begin(), expansion.nodes.end());
+            for (vector<uint8_t>& packed : expansion.states) {
+                next_frontier.push_back(move(packed));
+            }
+        }
+        levels.push_back(move(next_level));
+        frontier = move(next_frontier);
+    }
+    return false;
+}
+
+// Worker body for one level. emu belongs to this thread; loadState puts it in each parent's state.
+void StateExplorer::expandLevel(int worker, CHIP8& emu, Expansion& out) {
+    CHIP8::Snapshot parent;
+    CHIP8::Snapshot child;
+    uint16_t stop_pc = (goal.type == Goal::PC) ? goal.address : NO_ADDRESS;
+
+    uint32_t index;
+    while (!found && takeWork(worker, index)) {
+        unpack(frontier[index], parent);
+
+        for (int8_t choice = 0; choice < CHOICES && !found; ++choice) {
+            emu.loadState(parent);
+            emu.setKeys(choice == NO_KEY ? 0 : (1u << choice));
+            bool stopped = emu.runFrameUntil(stop_pc);
+
+            if (goalReached(emu, stopped)) {
+                lock_guard<mutex> guard(found_lock);
+                if (!found) {
+                    found_node = { index, choice };
+                    found = true;
+                }
+                break;
+            }
+            if (!emu.isRunning() || visited_count >= max_states || !markVisited(emu.stateHash())) {
+                continue;
+            }
+
+            emu.saveState(child);
+            out.nodes.push_back({ index, choice });
+            out.states.emplace_back();
+            pack(child, out.states.back());
+        }
+    }
+}
+
+// Own queue first, newest work first. Otherwise steal the oldest work of another thread.
+bool StateExplorer::takeWork(int worker, uint32_t& index) {
+    {
+        WorkQueue& own = queues[worker];
+        lock_guard<mutex> guard(own.lock);
+        if (!own.items.empty()) {
+            index = own.items.back();
+            own.items.pop_back();
+            return true;
+        }
+    }
+
+    for (int i = 1; i < thread_count; ++i) {
+        WorkQueue& victim = queues[(worker + i) % thread_count];
+        lock_guard<mutex> guard(victim.lock);
+        if (!victim.items.empty()) {
+            index = victim.items.front();
+            victim.items.pop_front();
+            return true;
+        }
+    }
+    return false; // Nothing is added during a level, so empty queues mean the level is done
+}
+
+bool StateExplorer::markVisited(uint64_t hash) {
+    Shard& shard = shards[hash >> 58]; // Top bits pick the shard, the set hashes on the low bits
+    lock_guard<mutex> guard(shard.lock);
+    if (!shard.hashes.insert(hash).second) {
+        return false;
+    }
+    visited_count++;
+    return true;
+}
+
+bool StateExplorer::goalReached(const CHIP8& emu, bool stopped_at_pc) const {
+    switch (goal.type) {
+        case Goal::CRASH: return !emu.isRunning();
+        case Goal::PC: return stopped_at_pc;
+        case Goal::MEMORY: return emu.isRunning() && emu.getMemory(goal.address) == goal.value;
+    }
+    return false;
+}
+
+// Follows the parent links from the goal back to the start
+void StateExplorer::buildMovie() {
+    movie.clear();
+    movie.push_back(found_node.choice);
+    uint32_t index = found_node.parent;
+    for (int level = depth - 1; level > 0; --level) {
+        const Node& node = levels[level][index];
+        movie.push_back(node.choice);
+        index = node.parent;
+    }
+    reverse(movie.begin(), movie.end());
+}
+
+// Layout: everything after the page array, then the owned pages in order
+void StateExplorer::pack(const CHIP8::Snapshot& state, vector<uint8_t>& out) {
+    const size_t head = offsetof(CHIP8::Snapshot, owned_pages);
+    const size_t tail = sizeof(CHIP8::Snapshot) - head;
+    const size_t page_size = sizeof(state.pages[0]);
+    const int page_count = sizeof(state.pages) / page_size;
+
+    out.resize(tail);
+    memcpy(out.data(), reinterpret_cast<const uint8_t*>(&state) + head, tail);
+    for (int i = 0; i < page_count; ++i) {
+        if (state.owned_pages & (1u << i)) {
+            out.insert(out.end(), state.pages[i], state.pages[i] + page_size);
+        }
+    }
+}
+
+void StateExplorer::unpack(const vector<uint8_t>& in, CHIP8::Snapshot& state) {
+    const size_t head = offsetof(CHIP8::Snapshot, owned_pages);
+    const size_t tail = sizeof(CHIP8::Snapshot) - head;
+    const size_t page_size = sizeof(state.pages[0]);
+    const int page_count = sizeof(state.pages) / page_size;
+
+    memcpy(reinterpret_cast<uint8_t*>(&state) + head, in.data(), tail);
+    size_t offset = tail;
+    for (int i = 0; i < page_count; ++i) {
+        if (state.owned_pages & (1u << i)) {
+            memcpy(state.pages[i], in.data() + offset, page_size);
+            offset += page_size;
+        }
+    }
+}
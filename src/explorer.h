@@ -0,0 +1,90 @@
+#pragma once // Ensures this header file is included only once
+
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <unordered_set>
+#include <vector>
+#include "chip8.h"
+
+// Breadth first search over input sequences. Every state branches once per frame on no key or one of the
+// 16 keys held, duplicate states are dropped by hash, and each level of the search is spread across threads.
+// The first level that reaches the goal gives the shortest input movie.
+class StateExplorer {
+public:
+    static constexpr int CHOICES = 17; // Keys 0-F, then no key
+    static constexpr int8_t NO_KEY = 16;
+
+    // What the search is looking for. Memory is compared at frame boundaries.
+    struct Goal {
+        enum Type { CRASH, PC, MEMORY } type;
+        uint16_t address;
+        uint8_t value;
+    };
+
+    // Parses "crash", "pc:ADDR" or "mem:ADDR:VAL" (hex)
+    static bool parseGoal(const std::string& text, Goal& goal);
+
+    StateExplorer(const std::string& rom_path, const Goal& goal, int threads, int max_frames, size_t max_states);
+
+    // Returns true if the goal was reached. The movie then holds one choice per frame.
+    bool explore();
+    const std::vector<int8_t>& getMovie() const { return movie; }
+    size_t statesVisited() const { return visited_count; }
+    int framesSearched() const { return depth; }
+
+private:
+    // Set of state hashes split into shards with their own lock, so threads rarely contend
+    static constexpr int SHARD_COUNT = 64;
+    struct alignas(64) Shard {
+        std::mutex lock;
+        std::unordered_set<uint64_t> hashes;
+    };
+
+    // Per thread queue of frontier indices. The owner takes from the back, idle threads steal from the front.
+    struct alignas(64) WorkQueue {
+        std::mutex lock;
+        std::deque<uint32_t> items;
+    };
+
+    // How a state was reached: index of the parent in the previous level and the choice made
+    struct Node {
+        uint32_t parent;
+        int8_t choice;
+    };
+
+    // New states found by one thread during a level
+    struct Expansion {
+        std::vector<Node> nodes;
+        std::vector<std::vector<uint8_t>> states;
+    };
+
+    std::string rom_path;
+    Goal goal;
+    int thread_count;
+    int max_frames;
+    size_t max_states;
+
+    Shard shards[SHARD_COUNT];
+    std::vector<WorkQueue> queues;
+    std::vector<std::vector<Node>> levels;      // levels[d] holds the states reached after d frames
+    std::vector<std::vector<uint8_t>> frontier; // Packed snapshots of the last level
+    std::atomic<size_t> visited_count;
+    std::atomic<bool> found;
+    std::mutex found_lock;
+    Node found_node;
+    int depth;
+    std::vector<int8_t> movie;
+
+    bool markVisited(uint64_t hash); // False if the state was seen before
+    bool takeWork(int worker, uint32_t& index);
+    void expandLevel(int worker, CHIP8& emu, Expansion& out);
+    bool goalReached(const CHIP8& emu, bool stopped_at_pc) const;
+    void buildMovie();
+
+    // Snapshots without the pages that still match the ROM image
+    static void pack(const CHIP8::Snapshot& state, std::vector<uint8_t>& out);
+    static void unpack(const std::vector<uint8_t>& in, CHIP8::Snapshot& state);
+};
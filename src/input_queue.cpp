@@ -0,0 +1,41 @@
+#include "input_queue.h"
+
+// Constructor
+InputQueue::InputQueue() : window_start_ns(0), window_end_ns(0) {
+    clear();
+}
+
+// Drops every pending event and forgets each key's last cycle
+void InputQueue::clear() {
+    count = 0;
+    for (uint64_t& cycle : last_cycle) {
+        cycle = 0;
+    }
+}
+
+// Inserts an event, keeping the queue sorted by cycle. Events on the same cycle keep their arrival order.
+bool InputQueue::push(uint64_t cycle, uint8_t key, bool down) {
+    if (count == CAPACITY) {
+        return false;
+    }
+
+    int i = count;
+    while (i > 0 && events[i - 1].cycle > cycle) {
+        events[i] = events[i - 1];
+        i--;
+    }
+    events[i] = { cycle, key, down };
+    count++;
+    last_cycle[key] = cycle;
+    return true;
+}
+
+// Removes and returns the oldest event. Only call when not empty.
+InputQueue::Event InputQueue::pop() {
+    Event front = events[0];
+    for (int i = 1; i < count; ++i) {
+        events[i - 1] = events[i];
+    }
+    count--;
+    return front;
+}
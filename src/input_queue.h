@@ -0,0 +1,43 @@
+#pragma once // Ensures this header file is included only once
+
+#include <cstdint>
+
+// Fixed size queue of key events ordered by the emulated cycle they take effect on.
+// The frontend fills it once per frame and the core drains it as it reaches each event's cycle.
+class InputQueue {
+public:
+    static constexpr int CAPACITY = 64;
+    static constexpr uint64_t NO_EVENT = UINT64_MAX;
+
+    struct Event {
+        uint64_t cycle; // Emulated cycle the event applies on
+        uint8_t key;    // CHIP-8 key 0x0-0xF
+        bool down;
+    };
+
+private:
+    Event events[CAPACITY]; // Sorted by cycle, oldest first
+    int count;
+    uint64_t last_cycle[16];  // Cycle of the latest event pushed per key
+    uint64_t window_start_ns; // Wall clock span the events being pushed were collected over
+    uint64_t window_end_ns;
+
+public:
+    InputQueue();
+
+    bool push(uint64_t cycle, uint8_t key, bool down); // False if the queue is full
+    Event pop();
+    void clear();
+
+    // Cycle of the oldest event, or NO_EVENT. Cheap enough to test before every instruction.
+    uint64_t nextCycle() const { return count ? events[0].cycle : NO_EVENT; }
+    bool empty() const { return count == 0; }
+    int size() const { return count; }
+    const Event& at(int index) const { return events[index]; }
+    uint64_t lastCycle(uint8_t key) const { return last_cycle[key]; }
+
+    // Polling window used to turn event timestamps into cycles
+    void setWindow(uint64_t start_ns, uint64_t end_ns) { window_start_ns = start_ns; window_end_ns = end_ns; }
+    uint64_t windowStart() const { return window_start_ns; }
+    uint64_t windowEnd() const { return window_end_ns; }
+};
@@ -0,0 +1,128 @@
+#include "logger.h"
+#include <iostream>
+#include <fstream>
+#include <iomanip>
+#include <ctime>
+#include <sstream>
+#ifdef _WIN32
+    #include <direct.h>
+#define MKDIR(path) _mkdir(path)
+#else
+    #include <sys/stat.h>
+    #define MKDIR(path) mkdir(path, 0755)
+#endif
+
+using namespace std;
+using namespace chrono;
+
+Logger& Logger::instance() {
+    static Logger logger;
+    return logger;
+}
+
+// Constructor. Opens the log file the first time anything is logged.
+Logger::Logger() {
+    initializeLogging();
+}
+
+// Destructor
+Logger::~Logger() {
+    writeLine("");
+    writeLine("========================================");
+    writeLine("Finished running!");
+    writeLine("========================================");
+    if (log_file.is_open()) {
+        log_file.close();
+    }
+}
+
+// Get current timestamp for logging (format: YYYY-MM-DD_HH-MM-SS_mmm)
+string Logger::getCurrentTimestamp() {
+    auto now = system_clock::now(); // std::chrono::system_clock::time_point object
+    auto time = system_clock::to_time_t(now); // converts into time_t integer
+    auto ms = duration_cast<milliseconds>(now.time_since_epoch()) % 1000; // gets milliseconds since epoch
+    
+    stringstream ss;
+    #ifdef _WIN32
+        struct tm timeinfo;
+        localtime_s(&timeinfo, &time); // fills timeinfo with current time data
+        ss << put_time(&timeinfo, "%Y-%m-%d_%H-%M-%S");
+    #else
+        ss << put_time(localtime(&time), "%Y-%m-%d_%H-%M-%S");
+    #endif
+    ss << "_" << setfill('0') << setw(3) << ms.count();
+    
+    return ss.str();
+}
+
+// Create directory if it doesn't exist (cross-platform)
+bool Logger::createDirectory(const string& path) {
+    try {
+        // Check if directory exists by trying to open a file in it
+        string test_file = path + "/.test";
+        ofstream test(test_file);
+        if (test.good()) {
+            test.close();
+            // Directory exists, delete test file
+            remove(test_file.c_str());
+            return true;
+        }
+        test.close();
+        
+        // Directory doesn't exist, try to create it
+        if (MKDIR(path.c_str()) == 0) {
+            return true;
+        }
+        return false;
+    } 
+    catch (const exception& e) {
+        cerr << "Error creating directory: " << e.what() << endl;
+        return false;
+    }
+}
+
+// Initialize logging system
+void Logger::initializeLogging() {
+    log_directory = "./logs";
+    
+    // Create logs directory if it doesn't exist
+    if (!createDirectory(log_directory)) {
+        cerr << "Warning: Could not create logs directory" << endl;
+        return;
+    }
+ 
+    // Create log filename with current timestamp
+    string timestamp = getCurrentTimestamp();
+    log_filename = log_directory + "/" + timestamp + ".txt";
+    
+    // Open log file for appending
+    log_file.open(log_filename, ios::app);
+    
+    if (!log_file.is_open()) {
+        cerr << "Warning: Could not open log file: " << log_filename << endl;
+        return;
+    }
+    
+    // Write header to log file
+    writeLine("========================================");
+    writeLine("CHIP-8 Emulator Log");
+    writeLine("Started at: " + timestamp);
+    writeLine("========================================");
+    writeLine("");
+}
+
+// Write message to the log file. Safe to call from any thread.
+void Logger::write(const string& message) {
+    lock_guard<mutex> guard(lock);
+    if (log_file.is_open()) {
+        log_file << message << endl;
+        log_file.flush();  // Flush to ensure data is written immediately
+    }
+}
+
+// Writes one line without taking the lock, for the header and footer
+void Logger::writeLine(const string& message) {
+    if (log_file.is_open()) {
+        log_file << message << endl;
+    }
+}
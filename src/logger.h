@@ -0,0 +1,27 @@
+#pragma once // Ensures this header file is included only once
+
+#include <chrono>
+#include <fstream>
+#include <mutex>
+#include <string>
+
+// Process wide log file in ./logs. Shared by every emulator instance so none of them carries its own file handle.
+class Logger {
+private:
+    std::mutex lock;
+    std::ofstream log_file;
+    std::string log_directory;
+    std::string log_filename;
+
+    Logger();
+    ~Logger();
+
+    void initializeLogging();
+    void writeLine(const std::string& message);
+    std::string getCurrentTimestamp();
+    bool createDirectory(const std::string& path);
+
+public:
+    static Logger& instance();
+    void write(const std::string& message);
+};
@@ -1,20 +1,91 @@
 #include "chip8.h"
+#include "debugger.h"
+#include "metrics.h"
+#include "rom_catalog.h"
+#include <cstdio>
 #include <iostream>
+#include <memory>
+#include <string>
 
 using namespace std;
 
 int main(int argc, char* argv[]) {
+    // Command line options
+    //   --roms DIR       ROM library directory (default ./assets/roms)
+    //   --rom NAME       ROM to start, by file name or leading digits of its SHA-1 (default space_invaders.ch8)
+    //   --list           print the ROM library and exit
+    //   --debug          start stopped at the first instruction with the debugger reading stdin
+    //   --metrics PATH   serve Prometheus metrics on the Unix domain socket at PATH
+    string rom_directory = "./assets/roms";
+    string rom_name = "space_invaders.ch8";
+    bool list = false;
+    bool debug = false;
+    string metrics_socket;
+    for (int i = 1; i < argc; ++i) {
+        string arg = argv[i];
+        if (arg == "--roms" && i + 1 < argc) {
+            rom_directory = argv[++i];
+        }
+        else if (arg == "--rom" && i + 1 < argc) {
+            rom_name = argv[++i];
+        }
+        else if (arg == "--list") {
+            list = true;
+        }
+        else if (arg == "--debug") {
+            debug = true;
+        }
+        else if (arg == "--metrics" && i + 1 < argc) {
+            metrics_socket = argv[++i];
+        }
+        else {
+            cerr << "Unknown option: " << arg << endl;
+            return 1;
+        }
+    }
+    
+    // Scan the ROM library. Only new or changed files are hashed.
+    ROMCatalog catalog(rom_directory);
+    if (!catalog.open()) {
+        return 1;
+    }
+    
+    if (list) {
+        for (size_t i = 0; i < catalog.size(); ++i) {
+            const ROMCatalog::Entry& entry = catalog.at(i);
+            printf("%s %5u  ipf=%-3d run_ahead=%d quirks=0x%02X  %s\n", SHA1::toHex(entry.sha1).c_str(), entry.size,
+                   entry.profile.cycles_per_frame, entry.profile.run_ahead_frames, entry.profile.quirks, entry.name.c_str());
+        }
+        return 0;
+    }
+    
+    int rom_index = catalog.find(rom_name);
+    if (rom_index < 0) {
+        cerr << "ROM not found in " << rom_directory << ": " << rom_name << endl;
+        return 1;
+    }
+    
     // Create CHIP-8 emulator instance
     CHIP8 emulator;
     
     // Load ROM
-    if (!emulator.loadROM("./assets/roms/space_invaders.ch8")) {
+    if (!emulator.loadFromCatalog(catalog, rom_index)) {
       cerr << "Failed to load ROM!" << endl;
         return 1;
     }
     
+    unique_ptr<Debugger> debugger;
+    if (debug) {
+        debugger = make_unique<Debugger>(emulator);
+        debugger->requestBreak();
+    }
+    
+    if (!metrics_socket.empty()) {
+        MetricsRegistry::instance().startServer(metrics_socket);
+    }
+    
     // Run the emulator
     emulator.run();
     
     return 0;
-}
\ No newline at end of file
+}
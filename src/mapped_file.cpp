@@ -0,0 +1,138 @@
+#include "mapped_file.h"
+#include <fstream>
+#ifdef _WIN32
+    #include <windows.h>
+#else
+    #include <fcntl.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <unistd.h>
+#endif
+
+using namespace std;
+
+// Constructor
+#ifdef _WIN32
+MappedFile::MappedFile() : bytes(nullptr), length(0), file_handle(INVALID_HANDLE_VALUE), mapping_handle(nullptr), mapped(false) {
+}
+#else
+MappedFile::MappedFile() : bytes(nullptr), length(0), mapped(false) {
+}
+#endif
+
+// Destructor
+MappedFile::~MappedFile() {
+    close();
+}
+
+#ifdef _WIN32
+
+bool MappedFile::open(const string& path) {
+    close();
+    file_handle = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file_handle == INVALID_HANDLE_VALUE) {
+        return false;
+    }
+    LARGE_INTEGER file_size;
+    if (!GetFileSizeEx(file_handle, &file_size)) {
+        close();
+        return false;
+    }
+    length = (size_t)file_size.QuadPart;
+    if (length == 0) { // Can't map an empty file
+        return true;
+    }
+
+    mapping_handle = CreateFileMappingA(file_handle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (mapping_handle) {
+        bytes = static_cast<const uint8_t*>(MapViewOfFile(mapping_handle, FILE_MAP_READ, 0, 0, 0));
+    }
+    if (bytes) {
+        mapped = true;
+        return true;
+    }
+
+    // Mapping failed, read it instead
+    if (mapping_handle) {
+        CloseHandle(mapping_handle);
+        mapping_handle = nullptr;
+    }
+    CloseHandle(file_handle);
+    file_handle = INVALID_HANDLE_VALUE;
+    ifstream file(path, ios::binary);
+    fallback.resize(length);
+    if (!file.read(reinterpret_cast<char*>(fallback.data()), length)) {
+        close();
+        return false;
+    }
+    bytes = fallback.data();
+    return true;
+}
+
+void MappedFile::close() {
+    if (mapped) {
+        UnmapViewOfFile(bytes);
+    }
+    if (mapping_handle) {
+        CloseHandle(mapping_handle);
+    }
+    if (file_handle != INVALID_HANDLE_VALUE) {
+        CloseHandle(file_handle);
+    }
+    mapping_handle = nullptr;
+    file_handle = INVALID_HANDLE_VALUE;
+    fallback.clear();
+    bytes = nullptr;
+    length = 0;
+    mapped = false;
+}
+
+#else
+
+bool MappedFile::open(const string& path) {
+    close();
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+    struct stat info;
+    if (fstat(fd, &info) != 0) {
+        ::close(fd);
+        return false;
+    }
+    length = (size_t)info.st_size;
+    if (length == 0) { // Can't map an empty file
+        ::close(fd);
+        return true;
+    }
+
+    void* view = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd); // The mapping stays valid
+    if (view != MAP_FAILED) {
+        bytes = static_cast<const uint8_t*>(view);
+        mapped = true;
+        return true;
+    }
+
+    // Mapping failed, read it instead
+    ifstream file(path, ios::binary);
+    fallback.resize(length);
+    if (!file.read(reinterpret_cast<char*>(fallback.data()), length)) {
+        close();
+        return false;
+    }
+    bytes = fallback.data();
+    return true;
+}
+
+void MappedFile::close() {
+    if (mapped) {
+        munmap(const_cast<uint8_t*>(bytes), length);
+    }
+    fallback.clear();
+    bytes = nullptr;
+    length = 0;
+    mapped = false;
+}
+
+#endif
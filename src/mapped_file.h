@@ -0,0 +1,31 @@
+#pragma once // Ensures this header file is included only once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Read only view of a whole file. Uses mmap or MapViewOfFile, and falls back to reading the file
+// into memory where mapping isn't possible.
+class MappedFile {
+private:
+    const uint8_t* bytes;
+    size_t length;
+    std::vector<uint8_t> fallback; // Holds the contents when the file could not be mapped
+#ifdef _WIN32
+    void* file_handle;
+    void* mapping_handle;
+#endif
+    bool mapped;
+
+public:
+    MappedFile();
+    ~MappedFile();
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    bool open(const std::string& path);
+    void close();
+    const uint8_t* data() const { return bytes; }
+    size_t size() const { return length; }
+};
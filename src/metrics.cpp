@@ -0,0 +1,264 @@
+#include "metrics.h"
+#include <cstdio>
+#include <iostream>
+#ifndef _WIN32
+    #include <poll.h>
+    #include <sys/socket.h>
+    #include <sys/stat.h>
+    #include <sys/un.h>
+    #include <unistd.h>
+#endif
+
+using namespace std;
+
+// Threads get slots in the order they first update a metric. Past METRICS_MAX_THREADS slots are shared,
+// which is still correct since updates are atomic adds.
+int metricsThreadSlot() {
+    static atomic<int> next_slot{ 0 };
+    thread_local int slot = next_slot.fetch_add(1, memory_order_relaxed) % METRICS_MAX_THREADS;
+    return slot;
+}
+
+uint64_t MetricCounter::value() const {
+    uint64_t total = 0;
+    for (const Slot& slot : slots) {
+        total += slot.value.load(memory_order_relaxed);
+    }
+    return total;
+}
+
+MetricHistogram::Slot::Slot() {
+    for (auto& bucket : buckets) {
+        bucket.store(0, memory_order_relaxed);
+    }
+}
+
+// upper_bounds must be sorted. Only the first METRICS_MAX_BUCKETS are used.
+MetricHistogram::MetricHistogram(const string& name, const string& help, const vector<double>& upper_bounds)
+    : bounds(upper_bounds), name(name), help(help) {
+    if (bounds.size() > METRICS_MAX_BUCKETS) {
+        bounds.resize(METRICS_MAX_BUCKETS);
+    }
+}
+
+void MetricHistogram::observe(double seconds) {
+    size_t bucket = 0;
+    while (bucket < bounds.size() && seconds > bounds[bucket]) {
+        bucket++;
+    }
+    Slot& slot = slots[metricsThreadSlot()];
+    slot.buckets[bucket].fetch_add(1, memory_order_relaxed);
+    slot.sum_ns.fetch_add(static_cast<uint64_t>(seconds * 1e9), memory_order_relaxed);
+}
+
+void MetricHistogram::write(string& out) const {
+    uint64_t counts[METRICS_MAX_BUCKETS + 1] = {};
+    uint64_t sum_ns = 0;
+    for (const Slot& slot : slots) {
+        for (size_t i = 0; i <= bounds.size(); ++i) {
+            counts[i] += slot.buckets[i].load(memory_order_relaxed);
+        }
+        sum_ns += slot.sum_ns.load(memory_order_relaxed);
+    }
+
+    char line[160];
+    uint64_t cumulative = 0;
+    for (size_t i = 0; i < bounds.size(); ++i) {
+        cumulative += counts[i];
+        snprintf(line, sizeof(line), "%s_bucket{le=\"%g\"} %llu\n", name.c_str(), bounds[i], (unsigned long long)cumulative);
+        out += line;
+    }
+    cumulative += counts[bounds.size()];
+    snprintf(line, sizeof(line), "%s_bucket{le=\"+Inf\"} %llu\n", name.c_str(), (unsigned long long)cumulative);
+    out += line;
+    snprintf(line, sizeof(line), "%s_sum %.9f\n%s_count %llu\n", name.c_str(), sum_ns / 1e9, name.c_str(), (unsigned long long)cumulative);
+    out += line;
+}
+
+// Mean of everything observed so far, in seconds
+double MetricHistogram::mean() const {
+    uint64_t count = 0;
+    uint64_t sum_ns = 0;
+    for (const Slot& slot : slots) {
+        for (size_t i = 0; i <= bounds.size(); ++i) {
+            count += slot.buckets[i].load(memory_order_relaxed);
+        }
+        sum_ns += slot.sum_ns.load(memory_order_relaxed);
+    }
+    return count ? (sum_ns / 1e9) / count : 0.0;
+}
+
+MetricsRegistry& MetricsRegistry::instance() {
+    static MetricsRegistry registry;
+    return registry;
+}
+
+MetricsRegistry::~MetricsRegistry() {
+    stopServer();
+}
+
+MetricCounter& MetricsRegistry::counter(const string& name, const string& help) {
+    lock_guard<mutex> guard(lock);
+    counters.push_back(make_unique<MetricCounter>(name, help));
+    return *counters.back();
+}
+
+MetricGauge& MetricsRegistry::gauge(const string& name, const string& help) {
+    lock_guard<mutex> guard(lock);
+    gauges.push_back(make_unique<MetricGauge>(name, help));
+    return *gauges.back();
+}
+
+MetricHistogram& MetricsRegistry::histogram(const string& name, const string& help, const vector<double>& upper_bounds) {
+    lock_guard<mutex> guard(lock);
+    histograms.push_back(make_unique<MetricHistogram>(name, help, upper_bounds));
+    return *histograms.back();
+}
+
+string MetricsRegistry::renderPrometheus() {
+    lock_guard<mutex> guard(lock);
+    string out;
+    char line[160];
+
+    for (const auto& counter : counters) {
+        out += "# HELP " + counter->name + " " + counter->help + "\n";
+        out += "# TYPE " + counter->name + " counter\n";
+        snprintf(line, sizeof(line), "%s %llu\n", counter->name.c_str(), (unsigned long long)counter->value());
+        out += line;
+    }
+    for (const auto& gauge : gauges) {
+        out += "# HELP " + gauge->name + " " + gauge->help + "\n";
+        out += "# TYPE " + gauge->name + " gauge\n";
+        snprintf(line, sizeof(line), "%s %g\n", gauge->name.c_str(), gauge->value());
+        out += line;
+    }
+    for (const auto& histogram : histograms) {
+        out += "# HELP " + histogram->name + " " + histogram->help + "\n";
+        out += "# TYPE " + histogram->name + " histogram\n";
+        histogram->write(out);
+    }
+    return out;
+}
+
+#ifndef _WIN32
+
+// Creates the listening socket and starts the exporter thread
+bool MetricsRegistry::startServer(const string& path) {
+    if (server_running) {
+        return true;
+    }
+
+    sockaddr_un address = {};
+    address.sun_family = AF_UNIX;
+    if (path.size() >= sizeof(address.sun_path)) {
+        cerr << "Error: Metrics socket path too long: " << path << endl;
+        return false;
+    }
+    snprintf(address.sun_path, sizeof(address.sun_path), "%s", path.c_str());
+
+    // A socket left over from a previous run is replaced, anything else at the path is left alone
+    struct stat existing;
+    if (lstat(path.c_str(), &existing) == 0) {
+        if (!S_ISSOCK(existing.st_mode)) {
+            cerr << "Error: Metrics path exists and is not a socket: " << path << endl;
+            return false;
+        }
+        unlink(path.c_str());
+    }
+
+    listen_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listen_fd < 0) {
+        cerr << "Error: Could not create metrics socket" << endl;
+        return false;
+    }
+    if (bind(listen_fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 || listen(listen_fd, 4) != 0) {
+        cerr << "Error: Could not listen on metrics socket: " << path << endl;
+        close(listen_fd);
+        listen_fd = -1;
+        return false;
+    }
+
+    struct stat bound;
+    if (lstat(path.c_str(), &bound) == 0) {
+        socket_device = bound.st_dev;
+        socket_inode = bound.st_ino;
+    }
+    socket_path = path;
+    server_running = true;
+    server = thread(&MetricsRegistry::serve, this);
+    return true;
+}
+
+void MetricsRegistry::stopServer() {
+    if (!server_running) {
+        return;
+    }
+    server_running = false;
+    server.join();
+    close(listen_fd);
+    listen_fd = -1;
+
+    // Another process may have replaced the socket since, only ours is removed
+    struct stat current;
+    if (lstat(socket_path.c_str(), &current) == 0 && S_ISSOCK(current.st_mode)
+        && (uint64_t)current.st_dev == socket_device && (uint64_t)current.st_ino == socket_inode) {
+        unlink(socket_path.c_str());
+    }
+}
+
+// Exporter thread. Each client gets one scrape: an HTTP response if it sent a request (curl --unix-socket),
+// the plain text otherwise (socat, nc -U).
+void MetricsRegistry::serve() {
+    while (server_running) {
+        pollfd listener = { listen_fd, POLLIN, 0 };
+        if (poll(&listener, 1, 200) <= 0) {
+            continue;
+        }
+        int client = accept(listen_fd, nullptr, nullptr);
+        if (client < 0) {
+            continue;
+        }
+
+        char request[512];
+        ssize_t received = 0;
+        pollfd reader = { client, POLLIN, 0 };
+        if (poll(&reader, 1, 100) > 0) {
+            received = recv(client, request, sizeof(request), 0);
+        }
+
+        string body = renderPrometheus();
+        string response;
+        if (received > 0) {
+            response = "HTTP/1.0 200 OK\r\nContent-Type: text/plain; version=0.0.4\r\nContent-Length: "
+                       + to_string(body.size()) + "\r\n\r\n" + body;
+        }
+        else {
+            response = body;
+        }
+
+        size_t sent = 0;
+        while (sent < response.size()) {
+            ssize_t n = send(client, response.data() + sent, response.size() - sent, MSG_NOSIGNAL);
+            if (n <= 0) {
+                break;
+            }
+            sent += n;
+        }
+        close(client);
+    }
+}
+
+#else
+
+bool MetricsRegistry::startServer(const string& path) {
+    cerr << "Warning: The metrics socket is not supported on Windows" << endl;
+    return false;
+}
+
+void MetricsRegistry::stopServer() {
+}
+
+void MetricsRegistry::serve() {
+}
+
+#endif
@@ -0,0 +1,104 @@
+#pragma once // Ensures this header file is included only once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Runtime metrics for long running sessions. Updates only touch the calling thread's slot, so they
+// never wait on a lock or on another thread. Slots are added up when the metrics are read.
+static constexpr int METRICS_MAX_THREADS = 16;
+static constexpr int METRICS_MAX_BUCKETS = 16;
+
+// Index of the calling thread's slot
+int metricsThreadSlot();
+
+class MetricCounter {
+private:
+    struct alignas(64) Slot {
+        std::atomic<uint64_t> value{ 0 };
+    };
+    Slot slots[METRICS_MAX_THREADS];
+
+public:
+    const std::string name;
+    const std::string help;
+
+    MetricCounter(const std::string& name, const std::string& help) : name(name), help(help) {}
+    void add(uint64_t n = 1) { slots[metricsThreadSlot()].value.fetch_add(n, std::memory_order_relaxed); }
+    uint64_t value() const;
+};
+
+// Last written value. Meant to be set by a single thread.
+class MetricGauge {
+private:
+    std::atomic<double> current{ 0.0 };
+
+public:
+    const std::string name;
+    const std::string help;
+
+    MetricGauge(const std::string& name, const std::string& help) : name(name), help(help) {}
+    void set(double value) { current.store(value, std::memory_order_relaxed); }
+    double value() const { return current.load(std::memory_order_relaxed); }
+};
+
+// Distribution of durations in seconds over fixed buckets
+class MetricHistogram {
+private:
+    struct alignas(64) Slot {
+        std::atomic<uint64_t> buckets[METRICS_MAX_BUCKETS + 1]; // Last one is +Inf
+        std::atomic<uint64_t> sum_ns{ 0 };
+        Slot();
+    };
+    std::vector<double> bounds;
+    Slot slots[METRICS_MAX_THREADS];
+
+public:
+    const std::string name;
+    const std::string help;
+
+    MetricHistogram(const std::string& name, const std::string& help, const std::vector<double>& upper_bounds);
+    void observe(double seconds);
+    void observeNS(uint64_t ns) { observe(ns / 1e9); }
+    void write(std::string& out) const; // Prometheus text lines for this histogram
+    double mean() const;
+};
+
+class MetricsRegistry {
+private:
+    std::mutex lock; // Guards registration and reads, never taken by updates
+    std::vector<std::unique_ptr<MetricCounter>> counters;
+    std::vector<std::unique_ptr<MetricGauge>> gauges;
+    std::vector<std::unique_ptr<MetricHistogram>> histograms;
+
+    // Unix domain socket exporter
+    std::thread server;
+    std::atomic<bool> server_running{ false };
+    int listen_fd = -1;
+    std::string socket_path;
+    uint64_t socket_device = 0; // Identify the socket file bound here, so only that one gets removed
+    uint64_t socket_inode = 0;
+    void serve();
+
+    MetricsRegistry() = default;
+
+public:
+    ~MetricsRegistry();
+    static MetricsRegistry& instance();
+
+    MetricCounter& counter(const std::string& name, const std::string& help);
+    MetricGauge& gauge(const std::string& name, const std::string& help);
+    MetricHistogram& histogram(const std::string& name, const std::string& help, const std::vector<double>& upper_bounds);
+
+    // Everything in the Prometheus text exposition format
+    std::string renderPrometheus();
+
+    // Serves renderPrometheus() to every client that connects to path. Not available on Windows.
+    bool startServer(const std::string& path);
+    void stopServer();
+};
+
@@ -0,0 +1,277 @@
+#include "rom_catalog.h"
+#include "logger.h"
+#include "mapped_file.h"
+#include <SDL3/SDL.h>
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <sstream>
+
+using namespace std;
+namespace fs = std::filesystem;
+
+static const char INDEX_MAGIC[4] = { 'C', '8', 'I', 'X' };
+
+// Index fields are stored as raw native endian values
+template <typename T>
+static void writeField(ofstream& out, const T& value) {
+    out.write(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+template <typename T>
+static void readField(ifstream& in, T& value) {
+    in.read(reinterpret_cast<char*>(&value), sizeof(T));
+}
+
+// Last write time of a file, 0 if it doesn't exist
+static int64_t modifiedTime(const string& path) {
+    error_code error;
+    fs::file_time_type time = fs::last_write_time(path, error);
+    return error ? 0 : static_cast<int64_t>(time.time_since_epoch().count());
+}
+
+// Keymap characters are letters and digits
+static uint16_t scancodeForChar(char c) {
+    c = toupper(static_cast<unsigned char>(c));
+    if (c >= 'A' && c <= 'Z') {
+        return SDL_SCANCODE_A + (c - 'A');
+    }
+    if (c >= '1' && c <= '9') {
+        return SDL_SCANCODE_1 + (c - '1');
+    }
+    if (c == '0') {
+        return SDL_SCANCODE_0;
+    }
+    return SDL_SCANCODE_UNKNOWN;
+}
+
+// Constructor
+ROMCatalog::ROMCatalog(const string& directory) : directory(directory) {
+}
+
+bool ROMCatalog::open() {
+    error_code error;
+    if (!fs::is_directory(directory, error)) {
+        cerr << "Error: ROM directory not found: " << directory << endl;
+        return false;
+    }
+
+    bool changed = !readIndex();
+    map<string, Entry> known;
+    for (Entry& entry : entries) {
+        known[entry.name] = entry;
+    }
+
+    // Files whose ROM and .cfg are unchanged keep their entry without being hashed again
+    vector<Entry> scanned;
+    for (const fs::directory_entry& file : fs::directory_iterator(directory, error)) {
+        string name = file.path().filename().string();
+        if (!file.is_regular_file(error) || file.path().extension() != ".ch8" || name.size() > 255) {
+            continue;
+        }
+
+        string rom_path = file.path().string();
+        Entry entry;
+        entry.name = name;
+        entry.rom_modified = modifiedTime(rom_path);
+        entry.cfg_modified = modifiedTime(rom_path + ".cfg");
+
+        auto previous = known.find(name);
+        if (previous != known.end() && previous->second.rom_modified == entry.rom_modified
+            && previous->second.cfg_modified == entry.cfg_modified) {
+            scanned.push_back(previous->second);
+            continue;
+        }
+
+        if (!hashROM(rom_path, entry)) {
+            cerr << "Warning: Could not read ROM: " << rom_path << endl;
+            continue;
+        }
+        readProfile(rom_path, entry.profile);
+        scanned.push_back(entry);
+        changed = true;
+    }
+
+    if (scanned.size() != entries.size()) { // Something was removed
+        changed = true;
+    }
+    sort(scanned.begin(), scanned.end(), [](const Entry& a, const Entry& b) { return a.name < b.name; });
+    entries = move(scanned);
+
+    if (changed && !writeIndex()) {
+        cerr << "Warning: Could not write ROM index in " << directory << endl;
+    }
+    return true;
+}
+
+string ROMCatalog::path(size_t index) const {
+    return (fs::path(directory) / entries[index].name).string();
+}
+
+int ROMCatalog::find(const string& name) const {
+    for (size_t i = 0; i < entries.size(); ++i) {
+        if (entries[i].name == name) {
+            return (int)i;
+        }
+    }
+
+    // Hash prefixes need a few digits to mean anything
+    if (name.size() < 4 || name.size() > 2 * SHA1::DIGEST_SIZE) {
+        return -1;
+    }
+    string prefix = name;
+    transform(prefix.begin(), prefix.end(), prefix.begin(), [](unsigned char c) { return (char)tolower(c); });
+    for (size_t i = 0; i < entries.size(); ++i) {
+        if (SHA1::toHex(entries[i].sha1).compare(0, prefix.size(), prefix) == 0) {
+            return (int)i;
+        }
+    }
+    return -1;
+}
+
+bool ROMCatalog::hashROM(const string& rom_path, Entry& entry) {
+    MappedFile file;
+    if (!file.open(rom_path)) {
+        return false;
+    }
+    SHA1 sha1;
+    sha1.update(file.data(), file.size());
+    sha1.finish(entry.sha1);
+    entry.size = (uint32_t)file.size();
+    return true;
+}
+
+// Reads optional per-ROM settings from "<rom>.cfg". Lines are key=value, # starts a comment.
+bool ROMCatalog::readProfile(const string& rom_path, ROMProfile& profile) {
+    ifstream settings(rom_path + ".cfg");
+    if (!settings.is_open()) {
+        return false;
+    }
+
+    string line;
+    while (getline(settings, line)) {
+        size_t comment = line.find('#');
+        if (comment != string::npos) {
+            line.erase(comment);
+        }
+        size_t equals = line.find('=');
+        if (equals == string::npos) {
+            continue;
+        }
+        string name = line.substr(0, equals);
+        string value = line.substr(equals + 1);
+        name.erase(0, name.find_first_not_of(" \t"));
+        name.erase(name.find_last_not_of(" \t\r") + 1);
+        value.erase(0, value.find_first_not_of(" \t"));
+        value.erase(value.find_last_not_of(" \t\r") + 1);
+
+        if (name == "run_ahead") {
+            profile.run_ahead_frames = (uint8_t)max(0, min(atoi(value.c_str()), 255));
+        }
+        else if (name == "cycles_per_frame") {
+            profile.cycles_per_frame = (uint8_t)max(0, min(atoi(value.c_str()), 255));
+        }
+        else if (name == "quirks") {
+            profile.quirks = 0;
+            stringstream list(value);
+            string quirk;
+            while (getline(list, quirk, ',')) {
+                quirk.erase(0, quirk.find_first_not_of(" \t"));
+                quirk.erase(quirk.find_last_not_of(" \t") + 1);
+                if (quirk == "shift_vy") {
+                    profile.quirks |= QUIRK_SHIFT_VY;
+                }
+                else if (quirk == "load_store_inc_i") {
+                    profile.quirks |= QUIRK_LOAD_STORE_INC_I;
+                }
+                else if (!quirk.empty() && quirk != "none") {
+                    Logger::instance().write("Warning: Unknown quirk: " + quirk);
+                }
+            }
+        }
+        else if (name == "keymap") { // Keyboard key for CHIP-8 keys 0 to F
+            if (value.size() != 16) {
+                Logger::instance().write("Warning: keymap needs 16 keys: " + value);
+                continue;
+            }
+            for (int i = 0; i < 16; ++i) {
+                profile.keymap[i] = scancodeForChar(value[i]);
+            }
+        }
+        else if (!name.empty()) {
+            Logger::instance().write("Warning: Unknown ROM setting: " + name);
+        }
+    }
+    return true;
+}
+
+// Layout: magic, version, count, then per entry the name length and name followed by the fixed size fields
+bool ROMCatalog::readIndex() {
+    entries.clear();
+    ifstream index(fs::path(directory) / INDEX_NAME, ios::binary);
+    if (!index.is_open()) {
+        return false;
+    }
+
+    char magic[4];
+    uint32_t version = 0;
+    uint32_t count = 0;
+    readField(index, magic);
+    readField(index, version);
+    readField(index, count);
+    if (!index || memcmp(magic, INDEX_MAGIC, sizeof(magic)) != 0 || version != INDEX_VERSION) {
+        return false;
+    }
+
+    for (uint32_t i = 0; i < count && index; ++i) {
+        Entry entry;
+        uint8_t name_length = 0;
+        readField(index, name_length);
+        entry.name.resize(name_length);
+        index.read(&entry.name[0], name_length);
+        readField(index, entry.sha1);
+        readField(index, entry.size);
+        readField(index, entry.rom_modified);
+        readField(index, entry.cfg_modified);
+        readField(index, entry.profile.quirks);
+        readField(index, entry.profile.cycles_per_frame);
+        readField(index, entry.profile.run_ahead_frames);
+        readField(index, entry.profile.keymap);
+        entries.push_back(entry);
+    }
+
+    if (!index) { // Truncated, rebuild it
+        entries.clear();
+        return false;
+    }
+    return true;
+}
+
+bool ROMCatalog::writeIndex() const {
+    ofstream index(fs::path(directory) / INDEX_NAME, ios::binary | ios::trunc);
+    if (!index.is_open()) {
+        return false;
+    }
+
+    writeField(index, INDEX_MAGIC);
+    writeField(index, INDEX_VERSION);
+    writeField(index, (uint32_t)entries.size());
+    for (const Entry& entry : entries) {
+        writeField(index, (uint8_t)entry.name.size());
+        index.write(entry.name.data(), entry.name.size());
+        writeField(index, entry.sha1);
+        writeField(index, entry.size);
+        writeField(index, entry.rom_modified);
+        writeField(index, entry.cfg_modified);
+        writeField(index, entry.profile.quirks);
+        writeField(index, entry.profile.cycles_per_frame);
+        writeField(index, entry.profile.run_ahead_frames);
+        writeField(index, entry.profile.keymap);
+    }
+    return index.good();
+}
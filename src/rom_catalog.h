@@ -0,0 +1,56 @@
+#pragma once // Ensures this header file is included only once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "sha1.h"
+
+// Quirks, for ROMs written against the original COSMAC VIP interpreter
+static constexpr uint8_t QUIRK_SHIFT_VY = 0x01;         // 8XY6/8XYE shift V[Y] into V[X]
+static constexpr uint8_t QUIRK_LOAD_STORE_INC_I = 0x02; // FX55/FX65 leave I past the last register
+
+// Settings a ROM runs with. Zero means the emulator default.
+struct ROMProfile {
+    uint8_t quirks = 0;
+    uint8_t cycles_per_frame = 0; // Instructions per 60 Hz frame
+    uint8_t run_ahead_frames = 0;
+    uint16_t keymap[16] = {};     // SDL scancode for each CHIP-8 key
+};
+
+// Library of the ROMs in a directory. The directory is scanned once and the result kept in a small
+// binary index next to the ROMs, so later starts only hash files that changed since.
+class ROMCatalog {
+public:
+    struct Entry {
+        std::string name;     // File name inside the directory
+        uint8_t sha1[SHA1::DIGEST_SIZE];
+        uint32_t size;
+        int64_t rom_modified; // Last write times, 0 when there is no .cfg
+        int64_t cfg_modified;
+        ROMProfile profile;
+    };
+
+    static constexpr const char* INDEX_NAME = "catalog.idx";
+    static constexpr uint32_t INDEX_VERSION = 1;
+
+    ROMCatalog(const std::string& directory);
+
+    // Reads the index, rescans the directory and rewrites the index if anything changed
+    bool open();
+
+    size_t size() const { return entries.size(); }
+    const Entry& at(size_t index) const { return entries[index]; }
+    std::string path(size_t index) const;
+    int find(const std::string& name) const; // File name or leading digits of the SHA-1, -1 if neither matches
+
+    // Reads "<rom>.cfg" into profile. Returns false if there is no such file.
+    static bool readProfile(const std::string& rom_path, ROMProfile& profile);
+
+private:
+    std::string directory;
+    std::vector<Entry> entries; // Sorted by name
+
+    bool readIndex();
+    bool writeIndex() const;
+    bool hashROM(const std::string& rom_path, Entry& entry);
+};
@@ -0,0 +1,118 @@
+#include "sha1.h"
+#include <cstring>
+
+using namespace std;
+
+static uint32_t rotateLeft(uint32_t value, int bits) {
+    return (value << bits) | (value >> (32 - bits));
+}
+
+// Constructor
+SHA1::SHA1() : total_bytes(0), buffered(0) {
+    state[0] = 0x67452301;
+    state[1] = 0xEFCDAB89;
+    state[2] = 0x98BADCFE;
+    state[3] = 0x10325476;
+    state[4] = 0xC3D2E1F0;
+}
+
+void SHA1::update(const uint8_t* data, size_t length) {
+    total_bytes += length;
+    while (length > 0) {
+        size_t count = 64 - buffered;
+        if (count > length) {
+            count = length;
+        }
+        memcpy(buffer + buffered, data, count);
+        buffered += count;
+        data += count;
+        length -= count;
+        if (buffered == 64) {
+            transform(buffer);
+            buffered = 0;
+        }
+    }
+}
+
+// Pads the message with its bit length and writes out the digest
+void SHA1::finish(uint8_t digest[DIGEST_SIZE]) {
+    uint64_t total_bits = total_bytes * 8;
+    uint8_t padding = 0x80;
+    update(&padding, 1);
+    padding = 0;
+    while (buffered != 56) {
+        update(&padding, 1);
+    }
+    uint8_t length_bytes[8];
+    for (int i = 0; i < 8; ++i) {
+        length_bytes[i] = (uint8_t)(total_bits >> (56 - 8 * i));
+    }
+    update(length_bytes, 8);
+
+    for (int i = 0; i < 5; ++i) {
+        digest[4 * i] = (uint8_t)(state[i] >> 24);
+        digest[4 * i + 1] = (uint8_t)(state[i] >> 16);
+        digest[4 * i + 2] = (uint8_t)(state[i] >> 8);
+        digest[4 * i + 3] = (uint8_t)state[i];
+    }
+}
+
+string SHA1::toHex(const uint8_t digest[DIGEST_SIZE]) {
+    static const char digits[] = "0123456789abcdef";
+    string text;
+    for (int i = 0; i < DIGEST_SIZE; ++i) {
+        text += digits[digest[i] >> 4];
+        text += digits[digest[i] & 0xF];
+    }
+    return text;
+}
+
+// Processes one 64 byte block
+void SHA1::transform(const uint8_t block[64]) {
+    uint32_t w[80];
+    for (int i = 0; i < 16; ++i) {
+        w[i] = (block[4 * i] << 24) | (block[4 * i + 1] << 16) | (block[4 * i + 2] << 8) | block[4 * i + 3];
+    }
+    for (int i = 16; i < 80; ++i) {
+        w[i] = rotateLeft(w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16], 1);
+    }
+
+    uint32_t a = state[0];
+    uint32_t b = state[1];
+    uint32_t c = state[2];
+    uint32_t d = state[3];
+    uint32_t e = state[4];
+
+    for (int i = 0; i < 80; ++i) {
+        uint32_t f;
+        uint32_t k;
+        if (i < 20) {
+            f = (b & c) | (~b & d);
+            k = 0x5A827999;
+        }
+        else if (i < 40) {
+            f = b ^ c ^ d;
+            k = 0x6ED9EBA1;
+        }
+        else if (i < 60) {
+            f = (b & c) | (b & d) | (c & d);
+            k = 0x8F1BBCDC;
+        }
+        else {
+            f = b ^ c ^ d;
+            k = 0xCA62C1D6;
+        }
+        uint32_t temp = rotateLeft(a, 5) + f + e + k + w[i];
+        e = d;
+        d = c;
+        c = rotateLeft(b, 30);
+        b = a;
+        a = temp;
+    }
+
+    state[0] += a;
+    state[1] += b;
+    state[2] += c;
+    state[3] += d;
+    state[4] += e;
+}
@@ -0,0 +1,25 @@
+#pragma once // Ensures this header file is included only once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// SHA-1 (FIPS 180-4), used to identify ROMs regardless of their file name
+class SHA1 {
+public:
+    static constexpr int DIGEST_SIZE = 20;
+
+    SHA1();
+    void update(const uint8_t* data, size_t length);
+    void finish(uint8_t digest[DIGEST_SIZE]);
+
+    static std::string toHex(const uint8_t digest[DIGEST_SIZE]);
+
+private:
+    uint32_t state[5];
+    uint64_t total_bytes;
+    uint8_t buffer[64];
+    size_t buffered;
+
+    void transform(const uint8_t block[64]);
+};